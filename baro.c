@@ -1,104 +1,4677 @@
+#include <errno.h>
 #include <signal.h>
+#include <stddef.h>
 #include "baro.h"
 
-struct baro__context baro__c = {0};
+#ifdef _WIN32
+#include <windows.h>
+#include <sys/stat.h>
+
+#define close _close
+#define write(fd, data, size) _write(fd, data, (unsigned) (size))
+typedef intptr_t ssize_t;
+#else
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+struct baro__test_list baro__tests = {0};
+
+#ifdef BARO__TEST_SECTION
+// Provided by the linker for the section that tests are placed in. They are
+// weak so that a suite without any tests still links.
+extern struct baro__test __start_baro_tests[] __attribute__((weak));
+extern struct baro__test __stop_baro_tests[] __attribute__((weak));
+#endif
+
+BARO__THREAD_LOCAL struct baro__context baro__c = {0};
+
+char *optarg;
+int optind = 1;
+
+struct long_option {
+    char const *name;
+    int has_arg;
+    int val;
+};
+
+// A small getopt-like function for parsing short and long CLI arguments. Long
+// options can take their argument either as "--name value" or "--name=value".
+// Arguments left after the options start at `optind`.
+int get_option(
+        int const num_args,
+        char * const * args,
+        char const * opts,
+        struct long_option const * long_opts) {
+    static char *arg = "";
+
+    if (!*arg) {
+        if (optind >= num_args || *(arg = args[optind]) != '-') {
+            arg = "";
+            return -1;
+        }
+        if (arg[1] && *++arg == '-') {
+            char * const name = arg + 1;
+            ++optind;
+            arg = "";
+
+            // A lone "--" ends the list of options
+            if (!*name) {
+                return -1;
+            }
+
+            size_t const name_len = strcspn(name, "=");
+            struct long_option const *long_opt = long_opts;
+            while (long_opt->name && (strlen(long_opt->name) != name_len ||
+                                      strncmp(long_opt->name, name, name_len) != 0)) {
+                long_opt++;
+            }
+
+            if (!long_opt->name) {
+                fprintf(stderr, "Illegal option: --%.*s\n", (int) name_len, name);
+                return 0;
+            }
+
+            if (!long_opt->has_arg) {
+                if (name[name_len] == '=') {
+                    fprintf(stderr, "Option does not take an argument: --%s\n", long_opt->name);
+                    return 0;
+                }
+                optarg = NULL;
+            } else if (name[name_len] == '=') {
+                optarg = &name[name_len + 1];
+            } else if (optind < num_args) {
+                optarg = args[optind++];
+            } else {
+                fprintf(stderr, "Option requires an argument: --%s\n", long_opt->name);
+                return 0;
+            }
+
+            return long_opt->val;
+        }
+    }
+
+    char opt;
+    char const *cur_opt;
+
+    if ((opt = *arg++) == ':' || !(cur_opt = strchr(opts, opt))) {
+        if (opt == '-') {
+            return -1;
+        }
+        if (!*arg) {
+            ++optind;
+        }
+        fprintf(stderr, "Illegal option: %c\n", opt);
+        return 0;
+    }
+
+    if (*++cur_opt != ':') {
+        optarg = NULL;
+        if (!*arg) {
+            ++optind;
+        }
+    } else {
+        if (*arg) {
+            optarg = arg;
+        } else if (num_args <= ++optind) {
+            arg = "";
+            fprintf(stderr, "Option requires an argument: %c\n", opt);
+            return 0;
+        } else {
+            optarg = args[optind];
+        }
+        arg = "";
+        ++optind;
+    }
+
+    return opt;
+}
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION mutex;
+typedef CONDITION_VARIABLE condition;
+typedef HANDLE thread;
+
+static void mutex_create(mutex *m) { InitializeCriticalSection(m); }
+static void mutex_destroy(mutex *m) { DeleteCriticalSection(m); }
+static void mutex_lock(mutex *m) { EnterCriticalSection(m); }
+static void mutex_unlock(mutex *m) { LeaveCriticalSection(m); }
+
+static void condition_create(condition *c) { InitializeConditionVariable(c); }
+static void condition_destroy(condition *c) { (void) c; }
+static void condition_wait(condition *c, mutex *m) { SleepConditionVariableCS(c, m, INFINITE); }
+static void condition_signal(condition *c) { WakeConditionVariable(c); }
+static void condition_broadcast(condition *c) { WakeAllConditionVariable(c); }
+
+#define atomic_load_long(p) InterlockedCompareExchange((p), 0, 0)
+#define atomic_store_long(p, v) InterlockedExchange((p), (v))
+#define atomic_add_long(p, v) InterlockedExchangeAdd((p), (v))
+#else
+typedef pthread_mutex_t mutex;
+typedef pthread_cond_t condition;
+typedef pthread_t thread;
+
+static void mutex_create(mutex *m) { pthread_mutex_init(m, NULL); }
+static void mutex_destroy(mutex *m) { pthread_mutex_destroy(m); }
+static void mutex_lock(mutex *m) { pthread_mutex_lock(m); }
+static void mutex_unlock(mutex *m) { pthread_mutex_unlock(m); }
+
+static void condition_create(condition *c) { pthread_cond_init(c, NULL); }
+static void condition_destroy(condition *c) { pthread_cond_destroy(c); }
+static void condition_wait(condition *c, mutex *m) { pthread_cond_wait(c, m); }
+static void condition_signal(condition *c) { pthread_cond_signal(c); }
+static void condition_broadcast(condition *c) { pthread_cond_broadcast(c); }
+
+#define atomic_load_long(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define atomic_store_long(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define atomic_add_long(p, v) __atomic_fetch_add((p), (v), __ATOMIC_ACQ_REL)
+#endif//_WIN32
+
+// A piece of work for the worker threads: one pass through a test. Passes
+// with an empty path explore the test from the top, and hand off every sibling
+// subtest they come across as a pass of its own, which is allocated along
+// with its path.
+struct work_unit {
+    size_t position;
+    struct baro__tag const **path;
+    size_t path_size;
+};
+
+// A double-ended queue of work units owned by a single worker. The owner
+// takes units from the front, while idle workers steal from the back.
+struct work_deque {
+    mutex lock;
+    struct work_unit **units;
+    size_t head;
+    size_t tail;
+    size_t capacity;
+};
+
+static void work_deque_create(
+        struct work_deque * const deque,
+        size_t const capacity) {
+    mutex_create(&deque->lock);
+    deque->capacity = capacity > 0 ? capacity : 1;
+    deque->units = calloc(deque->capacity, sizeof(struct work_unit *));
+    deque->head = deque->tail = 0;
+}
+
+static void work_deque_destroy(
+        struct work_deque * const deque) {
+    mutex_destroy(&deque->lock);
+    free(deque->units);
+}
+
+static void work_deque_push(
+        struct work_deque * const deque,
+        struct work_unit * const *units,
+        size_t const count) {
+    mutex_lock(&deque->lock);
+
+    // Compact the queue before growing it, as the front is only ever consumed
+    if (deque->head > 0) {
+        memmove(deque->units, &deque->units[deque->head],
+                (deque->tail - deque->head) * sizeof(struct work_unit *));
+        deque->tail -= deque->head;
+        deque->head = 0;
+    }
+
+    if (deque->tail + count > deque->capacity) {
+        while (deque->tail + count > deque->capacity) {
+            deque->capacity *= 2;
+        }
+
+        struct work_unit ** const old_units = deque->units;
+
+        deque->units = calloc(deque->capacity, sizeof(struct work_unit *));
+        memcpy(deque->units, old_units, deque->tail * sizeof(struct work_unit *));
+
+        free(old_units);
+    }
+
+    memcpy(&deque->units[deque->tail], units, count * sizeof(struct work_unit *));
+    deque->tail += count;
+
+    mutex_unlock(&deque->lock);
+}
+
+static int work_deque_pop(
+        struct work_deque * const deque,
+        struct work_unit ** const unit) {
+    mutex_lock(&deque->lock);
+
+    int const found = deque->head < deque->tail;
+    if (found) {
+        *unit = deque->units[deque->head++];
+    }
+
+    mutex_unlock(&deque->lock);
+    return found;
+}
+
+// Moves up to half of the remaining units from the back of the deque into
+// `units`, returning the number of units taken
+static size_t work_deque_steal(
+        struct work_deque * const deque,
+        struct work_unit ** const units,
+        size_t const max_count) {
+    mutex_lock(&deque->lock);
+
+    size_t count = (deque->tail - deque->head + 1) / 2;
+    if (count > max_count) {
+        count = max_count;
+    }
+
+    deque->tail -= count;
+    memcpy(units, &deque->units[deque->tail], count * sizeof(struct work_unit *));
+
+    mutex_unlock(&deque->lock);
+    return count;
+}
+
+uint64_t baro__now_ns(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (uint64_t) (counter.QuadPart / frequency.QuadPart) * 1000000000u +
+           (uint64_t) (counter.QuadPart % frequency.QuadPart) * 1000000000u / frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+#endif
+}
+
+// Hardware counters, read with perf_event_open on Linux. Each thread opens its
+// own the first time they are read, and a forked process opens them again, as
+// those it inherits count its parent. Counters that can't be opened, such as
+// in a container or a virtual machine without access to them, are skipped.
+#ifdef __linux__
+static BARO__THREAD_LOCAL int counter_fds[BARO__NUM_COUNTERS];
+static BARO__THREAD_LOCAL pid_t counters_pid;
+
+static void close_counters(void) {
+    if (counters_pid == 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < BARO__NUM_COUNTERS; i++) {
+        if (counter_fds[i] != -1) {
+            close(counter_fds[i]);
+        }
+    }
+    counters_pid = 0;
+}
+
+static void open_counters(void) {
+    static uint64_t const configs[BARO__NUM_COUNTERS] = {
+            [BARO__COUNTER_CYCLES] = PERF_COUNT_HW_CPU_CYCLES,
+            [BARO__COUNTER_INSTRUCTIONS] = PERF_COUNT_HW_INSTRUCTIONS,
+            [BARO__COUNTER_BRANCH_MISSES] = PERF_COUNT_HW_BRANCH_MISSES,
+            [BARO__COUNTER_CACHE_MISSES] = PERF_COUNT_HW_CACHE_MISSES,
+    };
+
+    close_counters();
+    for (size_t i = 0; i < BARO__NUM_COUNTERS; i++) {
+        struct perf_event_attr attr = {0};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[i];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        counter_fds[i] = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+    }
+    counters_pid = getpid();
+}
+
+unsigned baro__read_counters(
+        uint64_t values[BARO__NUM_COUNTERS]) {
+    if (counters_pid != getpid()) {
+        open_counters();
+    }
+
+    unsigned available = 0;
+    for (size_t i = 0; i < BARO__NUM_COUNTERS; i++) {
+        // When there are more counters than the hardware has room for, they
+        // take turns, and the count is scaled up to the whole time
+        uint64_t data[3];
+        if (counter_fds[i] == -1 || read(counter_fds[i], data, sizeof(data)) != sizeof(data) || data[2] == 0) {
+            continue;
+        }
+
+        values[i] = data[2] < data[1] ? (uint64_t) ((double) data[0] * data[1] / data[2]) : data[0];
+        available |= 1u << i;
+    }
+    return available;
+}
+#else
+static void close_counters(void) {
+}
+
+unsigned baro__read_counters(
+        uint64_t values[BARO__NUM_COUNTERS]) {
+    (void) values;
+    return 0;
+}
+#endif//__linux__
+
+// Counter values, and which of the counters they were read from were
+// available. Any one may be missing, so each is reported on its own.
+struct counters {
+    uint64_t values[BARO__NUM_COUNTERS];
+    unsigned available;
+};
+
+// Keys for the counters in the machine-readable formats
+static char const * const counter_keys[BARO__NUM_COUNTERS] = {
+        "cycles", "instructions", "branch_misses", "llc_misses",
+};
+
+static void counters_start(
+        struct counters * const start) {
+    start->available = baro__read_counters(start->values);
+}
+
+// Adds what the counters counted since `start` was read to `totals`
+static void counters_add_since(
+        struct counters * const totals,
+        struct counters const * const start) {
+    uint64_t values[BARO__NUM_COUNTERS];
+    unsigned const available = baro__read_counters(values) & start->available;
+    for (size_t i = 0; i < BARO__NUM_COUNTERS; i++) {
+        if (available & (1u << i)) {
+            totals->values[i] += values[i] - start->values[i];
+        }
+    }
+    totals->available |= available;
+}
+
+// Writes the counters that are available, each divided by `divisor`, as in
+// "1204 cycles, 3311 instructions". Returns the buffer.
+static char *format_counters(
+        char * const buffer,
+        size_t const size,
+        struct counters const * const counters,
+        double const divisor) {
+    size_t length = 0;
+    buffer[0] = '\0';
+    for (size_t i = 0; i < BARO__NUM_COUNTERS && length < size; i++) {
+        if (counters->available & (1u << i)) {
+            double const value = (double) counters->values[i] / divisor;
+            length += (size_t) snprintf(buffer + length, size - length, value < 100 ? "%s%.1f %s" : "%s%.0f %s",
+                                        length > 0 ? ", " : "", value, baro__counter_names[i]);
+        }
+    }
+    return buffer;
+}
+
+// What a test allocated over its passes, with BARO_TRACK_ALLOCS. Sizes are
+// those asked for, which don't depend on the allocator.
+struct alloc_stats {
+    int tracked;
+    uint64_t count;
+    uint64_t bytes;
+    uint64_t peak_bytes;
+    uint64_t leaked;
+    uint64_t leaked_bytes;
+};
+
+// Adds the allocations of one pass, or of several, to `totals`
+static void alloc_stats_add(
+        struct alloc_stats * const totals,
+        struct alloc_stats const * const stats) {
+    totals->tracked |= stats->tracked;
+    totals->count += stats->count;
+    totals->bytes += stats->bytes;
+    if (stats->peak_bytes > totals->peak_bytes) {
+        totals->peak_bytes = stats->peak_bytes;
+    }
+    totals->leaked += stats->leaked;
+    totals->leaked_bytes += stats->leaked_bytes;
+}
+
+// Allocation tracking, with the runner built with BARO_TRACK_ALLOCS. The runner
+// then takes the place of malloc, calloc, realloc and free, passing each call
+// on to the C library, and counts the calls a thread makes while it runs a
+// test. Each allocation is kept in a table with its size until it is freed, so
+// that the bytes live at once can be followed, and what's left in the table
+// once the pass is over was leaked. Allocations made by the runner itself, and
+// those of a benchmark, aren't tracked.
+#ifdef BARO_TRACK_ALLOCS
+#if !defined(__GLIBC__)
+#error "BARO_TRACK_ALLOCS needs glibc"
+#endif
+#if defined(__SANITIZE_ADDRESS__)
+#error "BARO_TRACK_ALLOCS can't be used along with AddressSanitizer, which replaces malloc too"
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#error "BARO_TRACK_ALLOCS can't be used along with AddressSanitizer, which replaces malloc too"
+#endif
+#endif
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+struct alloc_entry {
+    void *ptr;
+    size_t size;
+};
+
+// The allocations of the pass running on this thread, in an open-addressing
+// table that is allocated from the C library, so as not to track itself
+static BARO__THREAD_LOCAL struct {
+    int tracking;
+    struct alloc_entry *entries;
+    size_t size;
+    size_t capacity;
+    uint64_t live_bytes;
+    struct alloc_stats stats;
+} allocs;
+
+static size_t alloc_slot(
+        void const * const ptr) {
+    uint64_t const hash = (uint64_t) (uintptr_t) ptr * 0x9e3779b97f4a7c15ull;
+    return (size_t) (hash >> 32) & (allocs.capacity - 1);
+}
+
+static void alloc_insert(
+        void * const ptr,
+        size_t const size) {
+    if ((allocs.size + 1) * 2 > allocs.capacity) {
+        size_t const capacity = allocs.capacity ? allocs.capacity * 2 : 256;
+        struct alloc_entry * const entries = __libc_calloc(capacity, sizeof(struct alloc_entry));
+        if (entries == NULL) {
+            return;
+        }
+
+        struct alloc_entry * const old_entries = allocs.entries;
+        size_t const old_capacity = allocs.capacity;
+        allocs.entries = entries;
+        allocs.capacity = capacity;
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (old_entries[i].ptr != NULL) {
+                size_t slot = alloc_slot(old_entries[i].ptr);
+                while (entries[slot].ptr != NULL) {
+                    slot = (slot + 1) & (capacity - 1);
+                }
+                entries[slot] = old_entries[i];
+            }
+        }
+        __libc_free(old_entries);
+    }
+
+    size_t slot = alloc_slot(ptr);
+    while (allocs.entries[slot].ptr != NULL) {
+        slot = (slot + 1) & (allocs.capacity - 1);
+    }
+    allocs.entries[slot] = (struct alloc_entry) {ptr, size};
+    allocs.size++;
+}
+
+// Forgets an allocation, shifting back the entries that probed past it.
+// Returns zero if it wasn't tracked.
+static int alloc_remove(
+        void const * const ptr,
+        size_t * const size) {
+    if (allocs.size == 0) {
+        return 0;
+    }
+
+    size_t const mask = allocs.capacity - 1;
+    size_t slot = alloc_slot(ptr);
+    while (allocs.entries[slot].ptr != ptr) {
+        if (allocs.entries[slot].ptr == NULL) {
+            return 0;
+        }
+        slot = (slot + 1) & mask;
+    }
+    *size = allocs.entries[slot].size;
+    allocs.size--;
+
+    for (size_t next = (slot + 1) & mask; allocs.entries[next].ptr != NULL; next = (next + 1) & mask) {
+        size_t const home = alloc_slot(allocs.entries[next].ptr);
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            allocs.entries[slot] = allocs.entries[next];
+            slot = next;
+        }
+    }
+    allocs.entries[slot].ptr = NULL;
+    return 1;
+}
+
+static void alloc_track(
+        void * const ptr,
+        size_t const size) {
+    allocs.stats.count++;
+    allocs.stats.bytes += size;
+    allocs.live_bytes += size;
+    if (allocs.live_bytes > allocs.stats.peak_bytes) {
+        allocs.stats.peak_bytes = allocs.live_bytes;
+    }
+    alloc_insert(ptr, size);
+}
+
+static void alloc_untrack(
+        void const * const ptr) {
+    size_t size;
+    if (ptr != NULL && alloc_remove(ptr, &size)) {
+        allocs.live_bytes -= size;
+    }
+}
+
+void *malloc(
+        size_t const size) {
+    void * const ptr = __libc_malloc(size);
+    if (ptr != NULL && allocs.tracking) {
+        alloc_track(ptr, size);
+    }
+    return ptr;
+}
+
+void *calloc(
+        size_t const count,
+        size_t const size) {
+    void * const ptr = __libc_calloc(count, size);
+    if (ptr != NULL && allocs.tracking) {
+        alloc_track(ptr, count * size);
+    }
+    return ptr;
+}
+
+void *realloc(
+        void * const ptr,
+        size_t const size) {
+    void * const new_ptr = __libc_realloc(ptr, size);
+    if (allocs.tracking && (new_ptr != NULL || size == 0)) {
+        // Resizing to nothing frees the allocation
+        alloc_untrack(ptr);
+        if (new_ptr != NULL) {
+            alloc_track(new_ptr, size);
+        }
+    }
+    return new_ptr;
+}
+
+void free(
+        void * const ptr) {
+    if (allocs.tracking) {
+        alloc_untrack(ptr);
+    }
+    __libc_free(ptr);
+}
+
+uint64_t baro__num_allocs(void) {
+    return allocs.tracking ? allocs.stats.count : UINT64_MAX;
+}
+
+// Stops tracking around allocations the runner makes during a pass, returning
+// whether it was on
+int baro__pause_allocs(void) {
+    int const tracking = allocs.tracking;
+    allocs.tracking = 0;
+    return tracking;
+}
+
+void baro__resume_allocs(
+        int const tracking) {
+    allocs.tracking = tracking;
+}
+
+static void allocs_start(void) {
+    allocs.stats = (struct alloc_stats) {.tracked = 1};
+    allocs.live_bytes = 0;
+    allocs.tracking = 1;
+}
+
+// Stops tracking at the end of a pass, and counts what is left as leaked
+static void allocs_stop(
+        struct alloc_stats * const stats) {
+    if (!allocs.tracking) {
+        *stats = (struct alloc_stats) {0};
+        return;
+    }
+
+    allocs.tracking = 0;
+
+    allocs.stats.leaked = allocs.size;
+    allocs.stats.leaked_bytes = allocs.live_bytes;
+    *stats = allocs.stats;
+
+    if (allocs.size > 0) {
+        memset(allocs.entries, 0, allocs.capacity * sizeof(struct alloc_entry));
+        allocs.size = 0;
+    }
+}
+#else
+uint64_t baro__num_allocs(void) {
+    return UINT64_MAX;
+}
+
+int baro__pause_allocs(void) {
+    return 0;
+}
+
+void baro__resume_allocs(
+        int const tracking) {
+    (void) tracking;
+}
+
+static void allocs_start(void) {
+}
+
+static void allocs_stop(
+        struct alloc_stats * const stats) {
+    *stats = (struct alloc_stats) {0};
+}
+#endif//BARO_TRACK_ALLOCS
+
+// What the runner records about each test it runs
+struct test_result {
+    int ran;
+    uint64_t duration_ns;
+
+    // Time spent outside of subtest leaves, summed over every pass through
+    // the test. With many passes, this is what re-running the test costs.
+    uint64_t prefix_ns;
+    size_t num_passes;
+
+    // Set when a failure ended the test before all of its passes ran
+    int aborted;
+
+    size_t num_asserts;
+    size_t num_asserts_failed;
+
+    // The outcome of the test. When passes are scheduled on their own, these
+    // gather the outcome of all of them, while holding the results lock.
+    int failed;
+    size_t num_pending_units;
+
+    // The reports of finished passes, held until the test's result is written
+    // when results go out in one of the machine-readable formats
+    char *report;
+    size_t report_size;
+
+    // The hardware counters over every pass through the test, with --counters
+    struct counters counters;
+
+    // What every pass through the test allocated
+    struct alloc_stats allocs;
+
+    // The time per iteration of every sample taken of a benchmark, each of
+    // `bench_iterations` iterations, and what all of them counted
+    double *bench_samples;
+    size_t bench_num_samples;
+    size_t bench_iterations;
+    struct counters bench_counters;
+
+    // How a benchmark compared with its baseline, with --compare. The
+    // baseline may have been saved under the name it had before.
+    int bench_compared;
+    double bench_baseline_ns;
+    double bench_p_value;
+    char const *bench_renamed_from;
+};
+
+// A single pass through a test that ended up in a subtest leaf
+struct leaf_timing {
+    struct baro__test const *test;
+    struct baro__tag const *leaf;
+    uint64_t prefix_ns;
+    uint64_t leaf_ns;
+    struct alloc_stats allocs;
+};
+
+struct worker {
+    thread thread;
+    size_t id;
+
+    struct work_deque deque;
+    struct work_unit **stolen;
+    size_t stolen_capacity;
+
+    // Copied out of the worker's thread-local context once it finishes, and
+    // merged in worker order by the main thread
+    size_t num_tests_ran;
+    size_t num_tests_failed;
+    size_t num_asserts;
+    size_t num_asserts_failed;
+};
+
+// How results are written. Text is meant to be read by people, while the rest
+// are meant for tools, and are written one test at a time as they finish.
+enum result_format {
+    FORMAT_TEXT,
+    FORMAT_JSONL,
+    FORMAT_JUNIT,
+    FORMAT_TAP,
+};
+
+struct test_ids;
+struct baseline_table;
+
+static struct {
+    enum result_format format;
+    struct test_ids const *ids;
+
+    // The file given with --results, or -1
+    int results_fd;
+
+    int show_passed_tests;
+    int suppress_stdout;
+    int stop_after_failure;
+
+    // Set with --bench, to run benchmarks instead of tests, for about
+    // `bench_time_ns` each
+    int bench;
+    uint64_t bench_time_ns;
+
+    // Set with --counters, to read hardware counters around every pass
+    // through a test, and every sample of a benchmark
+    int counters;
+
+    // How long a test may run before it is cut short, with --timeout
+    uint64_t timeout_ns;
+
+    // The baselines given with --compare, and by how many percent a
+    // benchmark has to get slower than its baseline to fail
+    struct baseline_table *baseline;
+    double regression_threshold;
+
+    struct baro__test const *tests;
+    struct test_result *results;
+
+    size_t num_workers;
+    struct worker *workers;
+    struct work_unit *units;
+    mutex results_lock;
+
+    // Raised once a failure should stop every worker from starting new tests
+    long volatile stop;
+
+    // The subtest descriptions given with --path, after the test's own
+    char **subtest_filter;
+    size_t subtest_filter_size;
+
+    // Units that are queued or running. Idle workers keep looking for work
+    // until this drops to zero, as running units may still schedule more.
+    long volatile num_outstanding_units;
+
+    // Idle workers sleep on this until a unit is scheduled, which bumps the
+    // generation, or until the last unit is done or the run is stopped
+    mutex idle_lock;
+    condition work_available;
+    long volatile work_generation;
+
+    // When tests are running in parallel, all reports are written to this
+    // file while holding the lock
+    int report_fd;
+    mutex report_lock;
+
+    // The slowest passes through subtest leaves so far, kept with --slowest
+    size_t num_slowest;
+    struct leaf_timing *slowest_leaves;
+    size_t num_slowest_leaves;
+    mutex slowest_lock;
+} runner;
+
+static int write_all(
+        int const fd,
+        void const * const data,
+        size_t size) {
+    char const *p = data;
+    while (size > 0) {
+        ssize_t const written = write(fd, p, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 0;
+        }
+        p += written;
+        size -= written;
+    }
+    return 1;
+}
+
+// Writes out the reports formatted on this thread so far in a single write,
+// straight to the real stdout so that they are never captured along with the
+// output of the tests
+static void flush_report(void) {
+    struct baro__report * const report = &baro__c.report;
+    if (report->size == 0) {
+        return;
+    }
+
+    if (runner.num_workers > 0) {
+        mutex_lock(&runner.report_lock);
+        write_all(runner.report_fd, report->data, report->size);
+        mutex_unlock(&runner.report_lock);
+    } else {
+        fflush(stdout);
+        write_all(baro__c.real_stdout != -1 ? baro__c.real_stdout : fileno(stdout), report->data, report->size);
+    }
+    report->size = 0;
+}
+
+static void set_sigabrt_handler(void (*handler)(int)) {
+#ifdef _WIN32
+    signal(SIGABRT, handler);
+#else
+    struct sigaction action;
+    memset(&action, 0, sizeof(struct sigaction));
+    action.sa_handler = handler;
+    sigaction(SIGABRT, &action, NULL);
+#endif
+}
+
+static void handle_signal(int signum) {
+    if (signum == SIGABRT) {
+        // Other workers may still need the handler, so only remove it when
+        // running serially
+        if (runner.num_workers == 0) {
+            set_sigabrt_handler(NULL);
+        }
+
+        // Return to the main loop because we can't do anything useful while
+        // still in the signal handler
+        longjmp(baro__c.env, BARO__JMP_SIGABRT);
+    }
+}
+
+// Test timeouts, with --timeout. Once a test has run for too long, a timer
+// raises SIGALRM on the thread running it, and the handler jumps out of the
+// test from wherever it was. Tests are cut short without cleaning up after
+// them, so this is a last resort to keep one that hangs from stalling the
+// whole run. A test may be stopped in the middle of the C library, holding
+// locks that other threads would then wait on forever, which is why tests have
+// to run on a single thread, and why a worker process is replaced after one.
+#ifndef _WIN32
+enum timeout_state {
+    TIMEOUT_OFF,
+    TIMEOUT_ARMED,
+
+    // The runner is doing its own bookkeeping in the middle of a test, which
+    // mustn't be jumped out of
+    TIMEOUT_PAUSED,
+};
+
+static BARO__THREAD_LOCAL sig_atomic_t volatile timeout_state;
+
+// Set when the timer goes off while paused, to jump once resumed
+static BARO__THREAD_LOCAL sig_atomic_t volatile timeout_expired;
+
+// Set once a test has been cut short on this thread
+static BARO__THREAD_LOCAL int timeout_fired;
+
+static void handle_timeout(int signum) {
+    (void) signum;
+
+    // The test may have finished just as the timer went off
+    if (timeout_state == TIMEOUT_ARMED) {
+        timeout_state = TIMEOUT_OFF;
+        longjmp(baro__c.env, BARO__JMP_TIMEOUT);
+    } else if (timeout_state == TIMEOUT_PAUSED) {
+        timeout_expired = 1;
+    }
+}
+
+static void set_timeout_handler(void) {
+    // The handler doesn't return, so SIGALRM mustn't stay blocked after it
+    struct sigaction action;
+    memset(&action, 0, sizeof(struct sigaction));
+    action.sa_handler = handle_timeout;
+    action.sa_flags = SA_NODEFER | SA_RESTART;
+    sigaction(SIGALRM, &action, NULL);
+}
+
+#ifdef __linux__
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+// Timers aren't inherited by forked processes, so each creates its own
+static BARO__THREAD_LOCAL timer_t timeout_timer;
+static BARO__THREAD_LOCAL pid_t timeout_timer_pid;
+
+static void set_timer(
+        uint64_t const ns) {
+    if (timeout_timer_pid != getpid()) {
+        struct sigevent event;
+        memset(&event, 0, sizeof(struct sigevent));
+        event.sigev_notify = SIGEV_THREAD_ID;
+        event.sigev_signo = SIGALRM;
+        event.sigev_notify_thread_id = (pid_t) syscall(SYS_gettid);
+        if (timer_create(CLOCK_MONOTONIC, &event, &timeout_timer) != 0) {
+            return;
+        }
+        timeout_timer_pid = getpid();
+    }
+
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(struct itimerspec));
+    spec.it_value.tv_sec = (time_t) (ns / 1000000000u);
+    spec.it_value.tv_nsec = (long) (ns % 1000000000u);
+    timer_settime(timeout_timer, 0, &spec, NULL);
+}
+
+static void delete_timer(void) {
+    if (timeout_timer_pid == getpid()) {
+        timer_delete(timeout_timer);
+    }
+    timeout_timer_pid = 0;
+}
+#else
+static void set_timer(
+        uint64_t const ns) {
+    struct itimerval value;
+    memset(&value, 0, sizeof(struct itimerval));
+    value.it_value.tv_sec = (time_t) (ns / 1000000000u);
+    value.it_value.tv_usec = (suseconds_t) (ns % 1000000000u / 1000u);
+    setitimer(ITIMER_REAL, &value, NULL);
+}
+
+static void delete_timer(void) {
+}
+#endif//__linux__
+
+// Starts timing a test, or with `ns` of zero, stops
+static void set_timeout(
+        uint64_t const ns) {
+    if (runner.timeout_ns == 0) {
+        return;
+    }
+
+    // The flag goes down before the timer stops, and up before it starts, so
+    // that the handler never finds it out of date
+    if (ns == 0) {
+        timeout_state = TIMEOUT_OFF;
+        set_timer(0);
+        timeout_expired = 0;
+    } else {
+        timeout_expired = 0;
+        timeout_state = TIMEOUT_ARMED;
+        set_timer(ns);
+    }
+}
+
+// Keeps the timer from jumping out of the runner's own code until resumed
+static void pause_timeout(void) {
+    if (timeout_state == TIMEOUT_ARMED) {
+        timeout_state = TIMEOUT_PAUSED;
+    }
+}
+
+// Jumps out of the test if the timer went off while paused. The state goes up
+// before the check, so that the timer going off in between jumps right away.
+static void resume_timeout(void) {
+    if (timeout_state == TIMEOUT_PAUSED) {
+        timeout_state = TIMEOUT_ARMED;
+        if (timeout_expired) {
+            timeout_state = TIMEOUT_OFF;
+            longjmp(baro__c.env, BARO__JMP_TIMEOUT);
+        }
+    }
+}
+#else
+static void set_timeout(
+        uint64_t const ns) {
+    (void) ns;
+}
+
+static void pause_timeout(void) {
+}
+
+static void resume_timeout(void) {
+}
+
+static void delete_timer(void) {
+}
+#endif//_WIN32
+
+#ifndef _WIN32
+// Writes a string from a signal handler, where stdio can't be used
+static void write_string(
+        int const fd,
+        char const *str) {
+    size_t size = strlen(str);
+    while (size > 0) {
+        ssize_t const written = write(fd, str, size);
+        if (written <= 0) {
+            return;
+        }
+        str += written;
+        size -= (size_t) written;
+    }
+}
+
+static void write_number(
+        int const fd,
+        long value) {
+    char digits[24];
+    size_t i = sizeof(digits);
+    digits[--i] = '\0';
+    do {
+        digits[--i] = (char) ('0' + value % 10);
+        value /= 10;
+    } while (value > 0 && i > 0);
+    write_string(fd, &digits[i]);
+}
+
+// Results handed from a subtest process back to its parent. Subtest processes
+// run one at a time, so a single mapping is shared by all of them.
+struct subtest_fork_result {
+    int done;
+    int aborted;
+    int current_test_failed;
+    size_t num_asserts;
+    size_t num_asserts_failed;
+
+    // The size of the reports left in the report file
+    size_t report_size;
+};
+
+static struct subtest_fork_result *subtest_fork_result;
+static int subtest_report_fd = -1;
+
+// The subtest process being waited on, which is killed when the test times out
+static pid_t volatile subtest_pid;
+
+// Hands the reports of a subtest process to its parent, which writes them out
+// along with its own. Safe to call from a signal handler.
+static void send_subtest_report(void) {
+    struct baro__report const * const report = &baro__c.report;
+    size_t offset = 0;
+    while (offset < report->size) {
+        ssize_t const written = pwrite(subtest_report_fd, report->data + offset,
+                                       report->size - offset, (off_t) offset);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            break;
+        }
+        offset += (size_t) written;
+    }
+    subtest_fork_result->report_size = offset;
+}
+
+// The stderr the runner was started with, kept open for reports on tests that
+// end the process, as stderr itself may be captured or thrown away by then
+static int original_stderr = -1;
+
+// Captured output would be lost along with the process when a test ends it,
+// so the reason is reported along with the tail of that output before dying.
+// `number` follows `reason` unless it is negative.
+static void report_dying_test(
+        char const * const reason,
+        int const number) {
+    struct baro__test const * const test = baro__c.current_test;
+
+    // A subtest process is reported on by its parent, which shares its output
+    if (baro__c.fork_depth != 0) {
+        send_subtest_report();
+    } else if (test != NULL) {
+        // A report in the middle of the results would leave them unreadable
+        // by tools, so it goes to stderr when results are written for those
+        int out = runner.num_workers > 0 ? runner.report_fd
+                  : baro__c.real_stdout != -1 ? baro__c.real_stdout : 1;
+        if (runner.format != FORMAT_TEXT) {
+            out = original_stderr != -1 ? original_stderr : 2;
+        }
+
+        // Failures from before the crash haven't been written out yet
+        write_all(out, baro__c.report.data, baro__c.report.size);
+
+        write_string(out, reason);
+        if (number >= 0) {
+            write_number(out, number);
+        }
+        write_string(out, "\n  In: ");
+        write_string(out, test->tag->desc);
+        write_string(out, " (");
+        write_string(out, extract_file_name(test->tag->file_path));
+        write_string(out, ":");
+        write_number(out, test->tag->line_num);
+        write_string(out, ")\n");
+
+        int const capture = baro__c.stdout_capture;
+        off_t const size = capture != -1 ? lseek(capture, 0, SEEK_END) : 0;
+        if (size > 0) {
+            write_string(out, "Captured output:\n");
+
+            off_t offset = (size_t) size > baro__c.stdout_tail_size
+                           ? size - (off_t) baro__c.stdout_tail_size : 0;
+            char buffer[512];
+            while (offset < size) {
+                ssize_t const num_read = pread(capture, buffer, sizeof(buffer) - 1, offset);
+                if (num_read <= 0) {
+                    break;
+                }
+                buffer[num_read] = '\0';
+                write_string(out, buffer);
+                offset += num_read;
+            }
+            write_string(out, "\n");
+        }
+        write_string(out, BARO__SEPARATOR);
+    }
+}
+
+static void handle_crash(int signum) {
+    report_dying_test("Test crashed! Killed by signal ", signum);
+
+    signal(signum, SIG_DFL);
+    raise(signum);
+}
+
+// A test that calls exit() takes the runner down with it
+static void handle_exit(void) {
+    if (baro__c.current_test != NULL) {
+        fflush(stdout);
+        report_dying_test("Test ended the process", -1);
+    }
+}
+
+#if defined(__GNUC__) && defined(__ELF__)
+// Only defined when a sanitizer runtime is linked in
+extern void __sanitizer_set_report_fd(void *fd) __attribute__((weak));
+extern void __sanitizer_set_death_callback(void (*callback)(void)) __attribute__((weak));
+
+static void handle_sanitizer_death(void) {
+    report_dying_test("Test crashed! Stopped by a sanitizer", -1);
+}
+#endif
+
+// Only takes over signals that would otherwise kill the process outright, so
+// that handlers installed by sanitizers or debuggers still get them
+static void set_crash_handlers(void) {
+    int const signums[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL};
+    for (size_t i = 0; i < sizeof(signums) / sizeof(signums[0]); i++) {
+        struct sigaction previous;
+        if (sigaction(signums[i], NULL, &previous) != 0 || (previous.sa_flags & SA_SIGINFO) ||
+            previous.sa_handler != SIG_DFL) {
+            continue;
+        }
+
+        struct sigaction action;
+        memset(&action, 0, sizeof(struct sigaction));
+        action.sa_handler = handle_crash;
+        sigaction(signums[i], &action, NULL);
+    }
+
+    atexit(handle_exit);
+
+#if defined(__GNUC__) && defined(__ELF__)
+    // Sanitizer reports are written straight to the original stderr, as the
+    // one tests write to is gone along with the process
+    if (__sanitizer_set_report_fd != NULL && original_stderr != -1) {
+        __sanitizer_set_report_fd((void *) (intptr_t) original_stderr);
+    }
+    if (__sanitizer_set_death_callback != NULL) {
+        __sanitizer_set_death_callback(handle_sanitizer_death);
+    }
+#endif
+}
+#endif
+
+static uint64_t leaf_timing_total_ns(
+        struct leaf_timing const * const timing) {
+    return timing->prefix_ns + timing->leaf_ns;
+}
+
+// Keeps a pass if it is among the slowest seen so far
+static void record_leaf(
+        struct leaf_timing const * const timing) {
+    mutex_lock(&runner.slowest_lock);
+
+    if (runner.num_slowest_leaves < runner.num_slowest) {
+        runner.slowest_leaves[runner.num_slowest_leaves++] = *timing;
+    } else {
+        size_t fastest = 0;
+        for (size_t i = 1; i < runner.num_slowest_leaves; i++) {
+            if (leaf_timing_total_ns(&runner.slowest_leaves[i]) <
+                leaf_timing_total_ns(&runner.slowest_leaves[fastest])) {
+                fastest = i;
+            }
+        }
+
+        if (leaf_timing_total_ns(timing) > leaf_timing_total_ns(&runner.slowest_leaves[fastest])) {
+            runner.slowest_leaves[fastest] = *timing;
+        }
+    }
+
+    mutex_unlock(&runner.slowest_lock);
+}
+
+// The counters as they were when the current pass started, with --counters
+static BARO__THREAD_LOCAL struct counters pass_counters;
+
+// Accounts for one pass through a test. When the pass ended up in a subtest,
+// its time is split between that leaf and everything around it, which every
+// pass re-runs.
+static void end_pass(
+        struct baro__test const * const test,
+        struct test_result * const result,
+        uint64_t const start_ns) {
+    uint64_t const end_ns = baro__now_ns();
+    if (runner.counters) {
+        counters_add_since(&result->counters, &pass_counters);
+    }
+
+    struct alloc_stats allocs;
+    allocs_stop(&allocs);
+    alloc_stats_add(&result->allocs, &allocs);
+    if (allocs.leaked > 0) {
+        // Leaks are reported, but don't fail the test
+        struct baro__report * const out = &baro__c.report;
+        baro__report_printf(out, BARO__RED "Leaked %llu allocation%s, %llu bytes\n" BARO__UNSET_COLOR
+                                 "  In: %s (%s:%d)\n",
+                            (unsigned long long) allocs.leaked, allocs.leaked == 1 ? "" : "s",
+                            (unsigned long long) allocs.leaked_bytes, test->tag->desc,
+                            extract_file_name(test->tag->file_path), test->tag->line_num);
+        if (baro__c.leaf != NULL) {
+            baro__report_printf(out, "    Under: %s (%s:%d)\n", baro__c.leaf->desc,
+                                extract_file_name(baro__c.leaf->file_path), baro__c.leaf->line_num);
+        }
+        baro__report_printf(out, BARO__SEPARATOR);
+    }
+
+    uint64_t leaf_ns = 0;
+    if (baro__c.leaf != NULL) {
+        // A REQUIRE failure may have jumped out of the leaf before it ended
+        uint64_t const leaf_end_ns = baro__c.leaf_end_ns != 0 ? baro__c.leaf_end_ns : end_ns;
+        leaf_ns = leaf_end_ns - baro__c.leaf_start_ns;
+
+        if (runner.num_slowest > 0) {
+            struct leaf_timing const timing = {
+                    .test = test,
+                    .leaf = baro__c.leaf,
+                    .prefix_ns = end_ns - start_ns - leaf_ns,
+                    .leaf_ns = leaf_ns,
+                    .allocs = allocs,
+            };
+            record_leaf(&timing);
+        }
+    }
+
+    result->prefix_ns += end_ns - start_ns - leaf_ns;
+    result->num_passes++;
+}
+
+int baro__fork_subtest(
+        struct baro__tag const * const tag) {
+#ifdef _WIN32
+    (void) tag;
+    return 1;
+#else
+    if (subtest_fork_result == NULL) {
+        subtest_fork_result = mmap(NULL, sizeof(struct subtest_fork_result), PROT_READ | PROT_WRITE,
+                                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (subtest_fork_result == MAP_FAILED) {
+            fprintf(stderr, "Failed to map the subtest results\n");
+            exit(1);
+        }
+
+        subtest_report_fd = baro__open_memory_file("baro-subtest-report");
+        if (subtest_report_fd == -1) {
+            fprintf(stderr, "Failed to open the subtest report file\n");
+            exit(1);
+        }
+    }
+    subtest_fork_result->done = 0;
+    subtest_fork_result->report_size = 0;
+
+    // Captured output stays in the buffer for the child to report, but output
+    // that is shown as-is must not be written by both processes
+    if (!runner.suppress_stdout) {
+        fflush(stdout);
+    }
+    fflush(stderr);
+
+    pid_t const pid = fork();
+    if (pid < 0) {
+        // Run the subtest in this process instead, over another pass
+        return 1;
+    }
+
+    if (pid == 0) {
+        // The reports so far stay with the parent
+        baro__c.report.size = 0;
+        baro__c.fork_depth = baro__c.subtest_stack.size + 1;
+        return 1;
+    }
+
+    int status = 0;
+    subtest_pid = pid;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    subtest_pid = 0;
+
+    // Pick up the reports of the child, even when it crashed
+    struct baro__report * const report = &baro__c.report;
+    size_t const report_size = subtest_fork_result->report_size;
+    if (report_size > 0 &&
+        pread(subtest_report_fd, baro__report_reserve(report, report_size), report_size, 0) ==
+        (ssize_t) report_size) {
+        report->size += report_size;
+    }
+
+    if (subtest_fork_result->done && WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+        // The child started out with our counters, so it has the full picture
+        baro__c.current_test_failed = subtest_fork_result->current_test_failed;
+        baro__c.num_asserts = subtest_fork_result->num_asserts;
+        baro__c.num_asserts_failed = subtest_fork_result->num_asserts_failed;
+
+        // A REQUIRE failure ends the whole test, not just the subtest
+        if (subtest_fork_result->aborted) {
+            longjmp(baro__c.env, BARO__JMP_REQUIRE);
+        }
+        return 0;
+    }
+
+    baro__c.current_test_failed = 1;
+    baro__c.num_asserts_failed++;
+
+    baro__report_printf(report, BARO__RED "Test crashed! Subtest process %s %d\n" BARO__UNSET_COLOR,
+                        WIFSIGNALED(status) ? "killed by signal" : "exited with status",
+                        WIFSIGNALED(status) ? WTERMSIG(status) : WEXITSTATUS(status));
+
+    // As in a single process, a crash ends the test
+    baro__tag_list_push(&baro__c.subtest_stack, tag);
+    baro__assert_failed(report, BARO__ASSERT_REQUIRE, 1);
+    return 0;
+#endif
+}
+
+void baro__end_subtest_fork(
+        int const aborted) {
+#ifdef _WIN32
+    (void) aborted;
+#else
+    fflush(stdout);
+    fflush(stderr);
+    send_subtest_report();
+
+    subtest_fork_result->aborted = aborted;
+    subtest_fork_result->current_test_failed = baro__c.current_test_failed;
+    subtest_fork_result->num_asserts = baro__c.num_asserts;
+    subtest_fork_result->num_asserts_failed = baro__c.num_asserts_failed;
+    subtest_fork_result->done = 1;
+
+    _exit(0);
+#endif
+}
+
+// Benchmarks are sampled up to BENCH_MAX_SAMPLES times, with enough iterations
+// per sample for it to take about 1/BENCH_MAX_SAMPLES of the time given to
+// the benchmark. Once that time is up, sampling stops after BENCH_MIN_SAMPLES.
+#define BENCH_MAX_SAMPLES 30
+#define BENCH_MIN_SAMPLES 5
+
+// A benchmark that the compiler optimized down to nothing never takes long
+// enough, so calibration gives up past this many iterations
+#define BENCH_MAX_ITERATIONS ((size_t) 1 << 30)
+
+// What the iterations of the current benchmark counted, with --counters
+static BARO__THREAD_LOCAL struct counters bench_counters_start;
+static BARO__THREAD_LOCAL struct counters bench_counters;
+
+void baro__bench_count(
+        int const stop) {
+    if (!runner.counters) {
+        return;
+    }
+
+    if (stop) {
+        counters_add_since(&bench_counters, &bench_counters_start);
+    } else {
+        counters_start(&bench_counters_start);
+    }
+}
+
+// Times one sample of a benchmark. Without a BENCH_LOOP, the whole benchmark
+// is called for every iteration.
+static uint64_t bench_sample(
+        struct baro__test const * const test,
+        size_t const iterations) {
+    baro__c.bench_iterations = iterations;
+    baro__c.bench_elapsed_ns = 0;
+    baro__c.bench_looped = 0;
+
+    // A BENCH_LOOP starts counting over once it is reached
+    baro__bench_count(0);
+    uint64_t const start_ns = baro__now_ns();
+    test->func();
+    if (baro__c.bench_looped) {
+        return baro__c.bench_elapsed_ns;
+    }
+
+    for (size_t i = 1; i < iterations; i++) {
+        test->func();
+    }
+    uint64_t const end_ns = baro__now_ns();
+    baro__bench_count(1);
+    return end_ns - start_ns;
+}
+
+// Runs a benchmark in place of a pass through a test. The number of
+// iterations per sample grows until a sample takes long enough to time, after
+// which the samples are kept in `result`. A failing check ends the benchmark.
+static void bench_run(
+        struct baro__test const * const test,
+        struct test_result * const result) {
+    uint64_t const target_ns = runner.bench_time_ns / BENCH_MAX_SAMPLES;
+    uint64_t spent_ns = 0;
+
+    result->bench_num_samples = 0;
+    if (result->bench_samples == NULL) {
+        result->bench_samples = malloc(BENCH_MAX_SAMPLES * sizeof(double));
+    }
+
+    size_t iterations = 1;
+    for (;;) {
+        uint64_t const sample_ns = bench_sample(test, iterations);
+        spent_ns += sample_ns;
+        if (baro__c.current_test_failed || sample_ns >= target_ns || spent_ns >= runner.bench_time_ns ||
+            iterations >= BENCH_MAX_ITERATIONS) {
+            break;
+        }
+
+        // Aim a little past the target, going up by at least double and at
+        // most a hundred times
+        double const scale = sample_ns > 0 ? 1.2 * (double) target_ns / (double) sample_ns : 100;
+        double const next = iterations * (scale < 2 ? 2 : scale > 100 ? 100 : scale);
+        iterations = next < BENCH_MAX_ITERATIONS ? (size_t) next : BENCH_MAX_ITERATIONS;
+    }
+    result->bench_iterations = iterations;
+    bench_counters = (struct counters) {0};
+
+    while (!baro__c.current_test_failed && result->bench_num_samples < BENCH_MAX_SAMPLES &&
+           (result->bench_num_samples < BENCH_MIN_SAMPLES || spent_ns < runner.bench_time_ns)) {
+        uint64_t const sample_ns = bench_sample(test, iterations);
+        spent_ns += sample_ns;
+        result->bench_samples[result->bench_num_samples++] = (double) sample_ns / (double) iterations;
+    }
+    result->bench_counters = bench_counters;
+}
+
+// Robust statistics of a benchmark's samples: the median time per iteration,
+// the median absolute deviation from it, and the fastest sample
+struct bench_stats {
+    double median_ns;
+    double mad_ns;
+    double min_ns;
+};
+
+static int double_cmp(
+        void const * const a,
+        void const * const b) {
+    double const lhs = *(double const *) a;
+    double const rhs = *(double const *) b;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+static double sorted_median(
+        double const * const values,
+        size_t const size) {
+    return size % 2 != 0 ? values[size / 2] : (values[size / 2 - 1] + values[size / 2]) / 2;
+}
+
+static void bench_stats_compute(
+        struct bench_stats * const stats,
+        double const * const samples,
+        size_t const num_samples) {
+    double sorted[BENCH_MAX_SAMPLES];
+    memcpy(sorted, samples, num_samples * sizeof(double));
+    qsort(sorted, num_samples, sizeof(double), double_cmp);
+
+    stats->median_ns = sorted_median(sorted, num_samples);
+    stats->min_ns = sorted[0];
+
+    for (size_t i = 0; i < num_samples; i++) {
+        double const deviation = sorted[i] - stats->median_ns;
+        sorted[i] = deviation < 0 ? -deviation : deviation;
+    }
+    qsort(sorted, num_samples, sizeof(double), double_cmp);
+    stats->mad_ns = sorted_median(sorted, num_samples);
+}
+
+// Writes a time in the unit that fits it best, e.g. "12.3 ns" or "4.56 ms"
+static void format_bench_time(
+        char * const buffer,
+        size_t const size,
+        double const ns) {
+    if (ns < 1e3) {
+        snprintf(buffer, size, "%.1f ns", ns);
+    } else if (ns < 1e6) {
+        snprintf(buffer, size, "%.2f us", ns / 1e3);
+    } else if (ns < 1e9) {
+        snprintf(buffer, size, "%.2f ms", ns / 1e6);
+    } else {
+        snprintf(buffer, size, "%.2f s", ns / 1e9);
+    }
+}
+
+// Runs every pass through a test on the calling thread, or only the pass down
+// `path` when one is given. Returns non-zero if the test failed.
+static int run_passes(
+        struct baro__test const * const test,
+        struct baro__tag const * const * const path,
+        size_t const path_size,
+        struct test_result * const result) {
+    uint64_t const start_ns = baro__now_ns();
+
+    baro__c.current_test = test;
+    baro__c.current_test_failed = 0;
+    baro__subtest_trie_clear(&baro__c.subtests);
+    baro__c.subtest_path = path;
+    baro__c.subtest_path_size = path_size;
+
+    result->prefix_ns = 0;
+    result->num_passes = 0;
+    result->aborted = 0;
+    result->counters = (struct counters) {0};
+    result->allocs = (struct alloc_stats) {0};
+    uint64_t volatile pass_start_ns = 0;
+
+    size_t const num_asserts = baro__c.num_asserts;
+    size_t const num_asserts_failed = baro__c.num_asserts_failed;
+
+    int keep_running = 1;
+
+    int const jmp_val = setjmp(baro__c.env);
+    // The pass that was cut short still counts, unless the timer went off
+    // after it had already ended
+    if (jmp_val != 0) {
+        set_timeout(0);
+        if (pass_start_ns != 0) {
+            end_pass(test, result, pass_start_ns);
+        }
+    }
+
+    // Recover from REQUIRE assertion failures
+    if (jmp_val == BARO__JMP_REQUIRE) {
+        result->aborted = 1;
+        keep_running = 0;
+    }
+    // Recover from SIGABRT failures
+    else if (jmp_val == BARO__JMP_SIGABRT) {
+        baro__c.current_test_failed = 1;
+        baro__c.num_asserts_failed++;
+
+        struct baro__report * const out = &baro__c.report;
+
+        baro__report_printf(out, BARO__RED "Assertion failed! Caught SIGABRT\n" BARO__UNSET_COLOR);
+        baro__assert_failed(out, BARO__ASSERT_REQUIRE, 0);
+
+        result->aborted = 1;
+        keep_running = 0;
+    }
+    // Recover from tests that ran for too long
+    else if (jmp_val == BARO__JMP_TIMEOUT) {
+#ifndef _WIN32
+        // The timeout may have gone off while waiting on a subtest process
+        if (subtest_pid != 0) {
+            kill(subtest_pid, SIGKILL);
+            while (waitpid(subtest_pid, NULL, 0) < 0 && errno == EINTR) {
+            }
+            subtest_pid = 0;
+        }
+#endif
+        timeout_fired = 1;
+        baro__c.current_test_failed = 1;
+        baro__c.num_asserts_failed++;
+
+        struct baro__report * const out = &baro__c.report;
+
+        baro__report_printf(out, BARO__RED "Test timed out! Still running after %llu ms\n" BARO__UNSET_COLOR,
+                            (unsigned long long) (runner.timeout_ns / 1000000u));
+        baro__assert_failed(out, BARO__ASSERT_REQUIRE, 0);
+
+        result->aborted = 1;
+        keep_running = 0;
+    }
+    // Otherwise, install a SIGABRT handler, and start timing the test
+    else {
+        set_sigabrt_handler(handle_signal);
+        set_timeout(runner.timeout_ns);
+    }
+
+    while (keep_running) {
+        resume_timeout();
+
+        // Reset the current subtest stack
+        baro__c.should_reenter_subtest = 0;
+        baro__c.subtest_max_size = 0;
+        baro__tag_list_clear(&baro__c.subtest_stack);
+        baro__c.subtest_node = 0;
+        baro__c.leaf = NULL;
+
+        if (runner.counters) {
+            counters_start(&pass_counters);
+        }
+        pass_start_ns = baro__now_ns();
+        if (test->bench) {
+            bench_run(test, result);
+        } else {
+            allocs_start();
+            test->func();
+        }
+        pause_timeout();
+        end_pass(test, result, pass_start_ns);
+        pass_start_ns = 0;
+
+        // Keep looping until all subtest permutations have been visited
+        if (!baro__c.should_reenter_subtest) {
+            keep_running = 0;
+        }
+    }
+    set_timeout(0);
+
+    // A process forked to run a subtest may end up here after a REQUIRE
+    // failure inside of it, or after returning from the test early
+    if (baro__c.fork_depth != 0) {
+        baro__end_subtest_fork(jmp_val != 0);
+    }
+
+    result->ran = 1;
+    result->duration_ns = baro__now_ns() - start_ns;
+    result->num_asserts = baro__c.num_asserts - num_asserts;
+    result->num_asserts_failed = baro__c.num_asserts_failed - num_asserts_failed;
+    baro__c.current_test = NULL;
+
+    return baro__c.current_test_failed;
+}
+
+// Results in the machine-readable formats are built in a second buffer, out of
+// the reports and output in the first, and then swapped in for writing
+static BARO__THREAD_LOCAL struct baro__report formatted_result;
+
+static void format_result(
+        struct baro__test const *test,
+        struct test_result const *result,
+        int failed,
+        size_t number);
+
+static void record_result(
+        struct baro__test const *test,
+        struct test_result const *result,
+        int failed);
+
+static int bench_compare(
+        struct baro__test const *test,
+        struct test_result *result);
+
+// Counts and reports a test once all of its passes have run
+static void finish_test(
+        struct baro__test const * const test,
+        struct test_result const * const result,
+        int const failed) {
+    baro__c.num_tests_ran++;
+    if (failed) {
+        baro__c.num_tests_failed++;
+    }
+
+    if (runner.results_fd != -1) {
+        record_result(test, result, failed);
+    }
+
+    if (runner.format != FORMAT_TEXT) {
+        format_result(test, result, failed, (size_t) (test - runner.tests) + 1);
+    } else if (!failed && result->bench_num_samples > 0) {
+        // Benchmarks are shown whether or not passing tests are
+        struct bench_stats stats;
+        bench_stats_compute(&stats, result->bench_samples, result->bench_num_samples);
+
+        char median[32], mad[32], min[32];
+        format_bench_time(median, sizeof(median), stats.median_ns);
+        format_bench_time(mad, sizeof(mad), stats.mad_ns);
+        format_bench_time(min, sizeof(min), stats.min_ns);
+
+        struct baro__report * const out = &baro__c.report;
+        baro__report_printf(out,
+                            BARO__GREEN "Benchmark: %s (%s:%d)\n" BARO__UNSET_COLOR
+                            "%s per iteration (MAD %s, min %s)\n"
+                            "%zu samples of %zu iterations\n",
+                            test->tag->desc, extract_file_name(test->tag->file_path), test->tag->line_num,
+                            median, mad, min, result->bench_num_samples, result->bench_iterations);
+        if (result->bench_counters.available) {
+            char counters[160];
+            baro__report_printf(out, "%s per iteration\n",
+                                format_counters(counters, sizeof(counters), &result->bench_counters,
+                                                (double) result->bench_num_samples * result->bench_iterations));
+        }
+
+        if (result->bench_compared) {
+            char baseline[32];
+            format_bench_time(baseline, sizeof(baseline), result->bench_baseline_ns);
+            baro__report_printf(out, "Baseline: %s per iteration, %+.1f%% (p = %.3g)\n", baseline,
+                                (stats.median_ns / result->bench_baseline_ns - 1) * 100, result->bench_p_value);
+            if (result->bench_renamed_from != NULL) {
+                baro__report_printf(out, "  Saved as: %s\n", result->bench_renamed_from);
+            }
+        } else if (runner.baseline != NULL) {
+            baro__report_printf(out, "Baseline: none saved\n");
+        }
+        baro__report_printf(out, BARO__SEPARATOR);
+    } else if (!failed && runner.show_passed_tests) {
+        baro__report_printf(&baro__c.report,
+                            BARO__GREEN "Passed: %s (%s:%d)\n" BARO__UNSET_COLOR BARO__SEPARATOR,
+                            test->tag->desc, extract_file_name(test->tag->file_path), test->tag->line_num);
+    }
+    flush_report();
+
+    // Wipe the saved output between tests
+    baro__clear_output(&baro__c);
+}
+
+// Runs a single test, including every one of its subtest permutations, on the
+// calling thread. Returns non-zero if the test failed.
+static int run_test(
+        struct baro__test const * const test,
+        struct test_result * const result) {
+    int failed = run_passes(test, NULL, 0, result);
+    if (!failed && test->bench && runner.baseline != NULL) {
+        failed = bench_compare(test, result);
+    }
+
+    result->failed = failed;
+    finish_test(test, result, failed);
+    return failed;
+}
+
+// Wakes one idle worker for a unit that was just scheduled, or with `all` set,
+// every one of them to find out whether the run is over
+static void wake_idle_workers(
+        int const all) {
+    mutex_lock(&runner.idle_lock);
+    atomic_add_long(&runner.work_generation, 1);
+    if (all) {
+        condition_broadcast(&runner.work_available);
+    } else {
+        condition_signal(&runner.work_available);
+    }
+    mutex_unlock(&runner.idle_lock);
+}
+
+// The worker running on this thread, and the unit it is running
+static BARO__THREAD_LOCAL struct worker *current_worker;
+static BARO__THREAD_LOCAL struct work_unit const *current_unit;
+
+void baro__split_subtest(
+        struct baro__tag const * const tag) {
+    // The unit, and the deque it goes on, belong to the runner
+    size_t const path_size = baro__c.subtest_stack.size + 1;
+    pause_timeout();
+    int const tracking = baro__pause_allocs();
+    struct work_unit * const unit = malloc(sizeof(struct work_unit) +
+                                           path_size * sizeof(struct baro__tag const *));
+    unit->position = current_unit->position;
+    unit->path = (struct baro__tag const **) (unit + 1);
+    unit->path_size = path_size;
+    memcpy(unit->path, baro__c.subtest_stack.tags, (path_size - 1) * sizeof(struct baro__tag const *));
+    unit->path[path_size - 1] = tag;
+
+    mutex_lock(&runner.results_lock);
+    runner.results[unit->position].num_pending_units++;
+    mutex_unlock(&runner.results_lock);
+
+    atomic_add_long(&runner.num_outstanding_units, 1);
+    work_deque_push(&current_worker->deque, &unit, 1);
+    wake_idle_workers(0);
+    baro__resume_allocs(tracking);
+    resume_timeout();
+}
+
+// Runs one pass through a test, and finishes the test if it was the last one
+static void run_unit(
+        struct work_unit * const unit) {
+    struct baro__test const * const test = &runner.tests[unit->position];
+    struct test_result * const result = &runner.results[unit->position];
+
+    // Once a failure has ended the test, the passes it has left are dropped,
+    // as they would have been when running serially
+    mutex_lock(&runner.results_lock);
+    int const skip = result->aborted;
+    mutex_unlock(&runner.results_lock);
+
+    struct test_result pass = {0};
+    int pass_failed = 0;
+    if (!skip) {
+        current_unit = unit;
+        pass_failed = run_passes(test, (struct baro__tag const * const *) unit->path, unit->path_size, &pass);
+    }
+
+    mutex_lock(&runner.results_lock);
+    result->ran = 1;
+    result->duration_ns += pass.duration_ns;
+    result->prefix_ns += pass.prefix_ns;
+    result->num_passes += pass.num_passes;
+    result->aborted |= pass.aborted;
+    result->num_asserts += pass.num_asserts;
+    result->num_asserts_failed += pass.num_asserts_failed;
+    for (size_t i = 0; i < BARO__NUM_COUNTERS; i++) {
+        result->counters.values[i] += pass.counters.values[i];
+    }
+    result->counters.available |= pass.counters.available;
+    alloc_stats_add(&result->allocs, &pass.allocs);
+    result->failed |= pass_failed;
+    int const failed = result->failed;
+    int const finished = --result->num_pending_units == 0;
+
+    // A result carries the reports of every pass, wherever they ran
+    struct baro__report * const report = &baro__c.report;
+    if (runner.format != FORMAT_TEXT && report->size > 0) {
+        result->report = realloc(result->report, result->report_size + report->size);
+        memcpy(result->report + result->report_size, report->data, report->size);
+        result->report_size += report->size;
+        report->size = 0;
+    }
+    mutex_unlock(&runner.results_lock);
+
+    if (finished) {
+        if (result->report != NULL) {
+            memcpy(baro__report_reserve(report, result->report_size), result->report, result->report_size);
+            report->size += result->report_size;
+            free(result->report);
+            result->report = NULL;
+        }
+
+        finish_test(test, result, failed);
+        if (failed && runner.stop_after_failure) {
+            atomic_store_long(&runner.stop, 1);
+        }
+    }
+    flush_report();
+
+    if (unit->path_size > 0) {
+        free(unit);
+    }
+    if (atomic_add_long(&runner.num_outstanding_units, -1) == 1 || atomic_load_long(&runner.stop)) {
+        wake_idle_workers(1);
+    }
+}
+
+// Finds the next unit for a worker, first from its own deque and then by
+// stealing from the others. Returns zero once there is no work left anywhere.
+static int next_unit(
+        struct worker * const self,
+        struct work_unit ** const unit) {
+    while (1) {
+        long const generation = atomic_load_long(&runner.work_generation);
+        if (work_deque_pop(&self->deque, unit)) {
+            return 1;
+        }
+
+        size_t num_stolen = 0;
+        for (size_t i = 1; i < runner.num_workers && num_stolen == 0; i++) {
+            struct worker * const victim = &runner.workers[(self->id + i) % runner.num_workers];
+            num_stolen = work_deque_steal(&victim->deque, self->stolen, self->stolen_capacity);
+        }
+
+        if (num_stolen == 0) {
+            // Units still running elsewhere may yet schedule more subtests.
+            // Anything scheduled since looking bumped the generation.
+            mutex_lock(&runner.idle_lock);
+            while (atomic_load_long(&runner.work_generation) == generation &&
+                   atomic_load_long(&runner.num_outstanding_units) > 0 && !atomic_load_long(&runner.stop)) {
+                condition_wait(&runner.work_available, &runner.idle_lock);
+            }
+            int const done = atomic_load_long(&runner.num_outstanding_units) == 0 ||
+                             atomic_load_long(&runner.stop);
+            mutex_unlock(&runner.idle_lock);
+
+            if (done) {
+                return 0;
+            }
+            continue;
+        }
+
+        work_deque_push(&self->deque, self->stolen, num_stolen);
+    }
+}
+
+static void run_worker(
+        struct worker * const self) {
+    baro__context_create(&baro__c);
+    baro__c.split_subtests = 1;
+    baro__c.subtest_filter = (char const * const *) runner.subtest_filter;
+    baro__c.subtest_filter_size = runner.subtest_filter_size;
+    current_worker = self;
+
+    struct work_unit *unit;
+    while (!atomic_load_long(&runner.stop) && next_unit(self, &unit)) {
+        run_unit(unit);
+    }
+
+    self->num_tests_ran = baro__c.num_tests_ran;
+    self->num_tests_failed = baro__c.num_tests_failed;
+    self->num_asserts = baro__c.num_asserts;
+    self->num_asserts_failed = baro__c.num_asserts_failed;
+
+    baro__context_destroy(&baro__c);
+    free(formatted_result.data);
+    close_counters();
+    delete_timer();
+}
+
+#ifdef _WIN32
+static DWORD WINAPI worker_entry(LPVOID arg) {
+    run_worker(arg);
+    return 0;
+}
+
+static int thread_start(thread *t, struct worker *w) {
+    *t = CreateThread(NULL, 0, worker_entry, w, 0, NULL);
+    return *t != NULL;
+}
+
+static void thread_join(thread t) {
+    WaitForSingleObject(t, INFINITE);
+    CloseHandle(t);
+}
+#else
+static void *worker_entry(void *arg) {
+    run_worker(arg);
+    return NULL;
+}
+
+static int thread_start(thread *t, struct worker *w) {
+    return pthread_create(t, NULL, worker_entry, w) == 0;
+}
+
+static void thread_join(thread t) {
+    pthread_join(t, NULL);
+}
+#endif//_WIN32
+
+// Runs the tests on a pool of worker threads. Each worker starts with a
+// contiguous block of tests, and steals from the others once its own block
+// runs dry. Every subtest a pass comes across is scheduled as a pass of its
+// own, so that the subtests of a single large test are spread out as well.
+// When the tests are weighed up front, the blocks are sized to carry about the
+// same weight rather than the same number of tests.
+static void run_tests_in_parallel(
+        struct baro__test const * const tests,
+        uint64_t const * const weights,
+        size_t const num_tests,
+        size_t const num_threads) {
+    fflush(stdout);
+    int const real_stdout = baro__c.real_stdout != -1 ? baro__c.real_stdout : fileno(stdout);
+    runner.report_fd = dup(real_stdout);
+    if (runner.report_fd == -1) {
+        fprintf(stderr, "Failed to open the report stream\n");
+        exit(1);
+    }
+    mutex_create(&runner.report_lock);
+
+    // Output can't be told apart between tests running at the same time, so
+    // rather than capturing it, it is thrown away
+    if (runner.suppress_stdout) {
+        baro__disable_output(&baro__c, stdout);
+    }
+
+    runner.tests = tests;
+    runner.num_workers = num_threads;
+    runner.workers = calloc(num_threads, sizeof(struct worker));
+    runner.units = calloc(num_tests, sizeof(struct work_unit));
+    mutex_create(&runner.results_lock);
+    runner.num_outstanding_units = (long) num_tests;
+    mutex_create(&runner.idle_lock);
+    condition_create(&runner.work_available);
+
+    // Any worker may abort, so the handler has to be in place before they start
+    set_sigabrt_handler(handle_signal);
+
+    uint64_t total_weight = 0;
+    for (size_t i = 0; weights != NULL && i < num_tests; i++) {
+        total_weight += weights[i];
+    }
+
+    size_t block_end = 0;
+    uint64_t weight_so_far = 0;
+    for (size_t i = 0; i < num_threads; i++) {
+        struct worker * const worker = &runner.workers[i];
+        worker->id = i;
+
+        size_t const block_begin = block_end;
+        if (weights == NULL) {
+            block_end = num_tests * (i + 1) / num_threads;
+        } else {
+            uint64_t const target = total_weight * (i + 1) / num_threads;
+            while (block_end < num_tests && weight_so_far + weights[block_end] / 2 < target) {
+                weight_so_far += weights[block_end++];
+            }
+            if (i + 1 == num_threads) {
+                block_end = num_tests;
+            }
+        }
+
+        work_deque_create(&worker->deque, block_end - block_begin);
+        for (size_t j = block_begin; j < block_end; j++) {
+            runner.units[j].position = j;
+            runner.results[j].num_pending_units = 1;
+            worker->deque.units[worker->deque.tail++] = &runner.units[j];
+        }
+
+        worker->stolen_capacity = num_tests;
+        worker->stolen = calloc(num_tests, sizeof(struct work_unit *));
+    }
+
+    size_t num_started = 0;
+    for (; num_started < num_threads; num_started++) {
+        if (!thread_start(&runner.workers[num_started].thread, &runner.workers[num_started])) {
+            fprintf(stderr, "Failed to start worker thread %zu\n", num_started + 1);
+            atomic_store_long(&runner.stop, 1);
+            wake_idle_workers(1);
+            break;
+        }
+    }
+
+    // Merge the results in a fixed order so the summary is deterministic
+    for (size_t i = 0; i < num_started; i++) {
+        struct worker * const worker = &runner.workers[i];
+        thread_join(worker->thread);
+
+        baro__c.num_tests_ran += worker->num_tests_ran;
+        baro__c.num_tests_failed += worker->num_tests_failed;
+        baro__c.num_asserts += worker->num_asserts;
+        baro__c.num_asserts_failed += worker->num_asserts_failed;
+    }
+
+    for (size_t i = 0; i < num_threads; i++) {
+        // Passes left behind after stopping early still need to be freed
+        struct work_unit *unit;
+        while (work_deque_pop(&runner.workers[i].deque, &unit)) {
+            if (unit->path_size > 0) {
+                free(unit);
+            }
+        }
+
+        work_deque_destroy(&runner.workers[i].deque);
+        free(runner.workers[i].stolen);
+    }
+    free(runner.workers);
+    runner.workers = NULL;
+    runner.num_workers = 0;
+    free(runner.units);
+    runner.units = NULL;
+    mutex_destroy(&runner.results_lock);
+    condition_destroy(&runner.work_available);
+    mutex_destroy(&runner.idle_lock);
+
+    close(runner.report_fd);
+    runner.report_fd = -1;
+    mutex_destroy(&runner.report_lock);
+
+    baro__redirect_output(&baro__c, runner.suppress_stdout);
+}
+
+#ifndef _WIN32
+// What a worker is up to, so that the runner can report which test took it
+// down, and hand the rest of its batch to the worker that replaces it
+struct fork_worker_state {
+    // The test being run, or FORK_WORKER_IDLE
+    size_t volatile current;
+
+    // The tests of the batch that haven't been started yet
+    size_t volatile next;
+    size_t volatile end;
+};
+
+// State shared between the runner and its forked workers, mapped into every
+// process before forking
+struct fork_queue {
+    // Position of the next test to hand out
+    size_t volatile next;
+    long volatile stop;
+
+    struct fork_worker_state workers[];
+};
+
+#define FORK_WORKER_IDLE ((size_t) -1)
+
+// Header of each result streamed from a worker back to the runner, followed
+// by `report_size` bytes of report text and `num_leaves` leaf timings. The
+// tests and tags those point to sit at the same addresses in every process.
+struct fork_result {
+    uint64_t position;
+    uint64_t num_asserts;
+    uint64_t num_asserts_failed;
+    uint64_t duration_ns;
+    uint64_t prefix_ns;
+    uint64_t num_passes;
+    uint32_t failed;
+    uint32_t report_size;
+    uint32_t num_leaves;
+    uint32_t padding;
+    struct counters counters;
+    struct alloc_stats allocs;
+};
+
+// Hands out a batch of tests that shrinks as the queue drains, so that workers
+// take few trips to the queue early on but still finish at about the same time
+static size_t fork_queue_take(
+        struct fork_queue * const queue,
+        size_t const num_tests,
+        size_t const num_workers,
+        size_t * const first) {
+    size_t next = __atomic_load_n(&queue->next, __ATOMIC_ACQUIRE);
+    size_t batch;
+    do {
+        if (next >= num_tests) {
+            return 0;
+        }
+
+        batch = (num_tests - next) / (num_workers * 4);
+        if (batch < 1) {
+            batch = 1;
+        } else if (batch > 64) {
+            batch = 64;
+        }
+    } while (!__atomic_compare_exchange_n(&queue->next, &next, next + batch, 0,
+                                          __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+    *first = next;
+    return batch;
+}
+
+static void run_fork_worker(
+        struct fork_queue * const queue,
+        size_t const slot,
+        struct baro__test const * const tests,
+        size_t const num_tests,
+        size_t const num_workers,
+        int const result_fd) {
+    // Everything this worker prints, including reports, goes into a scratch
+    // file that is sent back to the runner after every test
+    int const capture_fd = baro__open_memory_file("baro-report");
+    if (capture_fd == -1) {
+        _exit(1);
+    }
+
+    fflush(stdout);
+    dup2(capture_fd, fileno(stdout));
+    if (baro__c.real_stdout != -1) {
+        dup2(capture_fd, baro__c.real_stdout);
+    }
+
+    // The captured output of the runner is shared with every other worker
+    if (baro__c.stdout_capture != -1) {
+        close(baro__c.stdout_capture);
+        baro__c.stdout_capture = -1;
+    }
+    baro__redirect_output(&baro__c, runner.suppress_stdout);
+
+    char *report = NULL;
+    size_t report_capacity = 0;
+
+    // A worker replacing one that died first finishes the batch it left
+    struct fork_worker_state * const state = &queue->workers[slot];
+    size_t first = state->next;
+    size_t count = state->end - state->next;
+    while (!__atomic_load_n(&queue->stop, __ATOMIC_ACQUIRE) &&
+           (count > 0 || (count = fork_queue_take(queue, num_tests, num_workers, &first)) > 0)) {
+        state->next = first;
+        state->end = first + count;
+        count = 0;
+        for (size_t i = first; i < state->end; i++) {
+            if (__atomic_load_n(&queue->stop, __ATOMIC_ACQUIRE)) {
+                break;
+            }
+
+            state->current = i;
+            state->next = i + 1;
+
+            size_t const num_asserts = baro__c.num_asserts;
+            size_t const num_asserts_failed = baro__c.num_asserts_failed;
+
+            struct test_result result = {0};
+            int const failed = run_test(&tests[i], &result);
+            if (failed && runner.stop_after_failure) {
+                __atomic_store_n(&queue->stop, 1, __ATOMIC_RELEASE);
+            }
+
+            fflush(stdout);
+            off_t const report_size = lseek(capture_fd, 0, SEEK_END);
+            if (report_size > 0 && (size_t) report_size > report_capacity) {
+                free(report);
+                report_capacity = report_size;
+                report = malloc(report_capacity);
+            }
+            if (report_size > 0 && pread(capture_fd, report, report_size, 0) != report_size) {
+                _exit(1);
+            }
+            if (ftruncate(capture_fd, 0) != 0) {
+                _exit(1);
+            }
+            lseek(capture_fd, 0, SEEK_SET);
+
+            struct fork_result const header = {
+                    .position = i,
+                    .num_asserts = baro__c.num_asserts - num_asserts,
+                    .num_asserts_failed = baro__c.num_asserts_failed - num_asserts_failed,
+                    .duration_ns = result.duration_ns,
+                    .prefix_ns = result.prefix_ns,
+                    .num_passes = result.num_passes,
+                    .failed = failed,
+                    .report_size = report_size > 0 ? (uint32_t) report_size : 0,
+                    .num_leaves = (uint32_t) runner.num_slowest_leaves,
+                    .counters = result.counters,
+                    .allocs = result.allocs,
+            };
+            if (!write_all(result_fd, &header, sizeof(header)) ||
+                !write_all(result_fd, report, header.report_size) ||
+                !write_all(result_fd, runner.slowest_leaves,
+                           header.num_leaves * sizeof(struct leaf_timing))) {
+                _exit(1);
+            }
+
+            // The runner keeps the overall slowest, so only send each pass once
+            runner.num_slowest_leaves = 0;
+
+            state->current = FORK_WORKER_IDLE;
+
+            // A test that timed out may have been stopped anywhere, leaving
+            // this process in no shape to run more, so another takes over
+            if (timeout_fired) {
+                _exit(0);
+            }
+        }
+    }
+
+    _exit(0);
+}
+
+struct fork_worker {
+    pid_t pid;
+    int fd;
+
+    // Partially received results
+    char *buffer;
+    size_t size;
+    size_t capacity;
+};
+
+// A finished test, held until every test before it has been printed
+struct fork_slot {
+    int done;
+    char *report;
+    size_t report_size;
+};
+
+static void fork_worker_start(
+        struct fork_worker * const worker,
+        struct fork_queue * const queue,
+        size_t const slot,
+        struct baro__test const * const tests,
+        size_t const num_tests,
+        size_t const num_workers) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        fprintf(stderr, "Failed to create a pipe for worker %zu\n", slot + 1);
+        exit(1);
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t const pid = fork();
+    if (pid < 0) {
+        fprintf(stderr, "Failed to fork worker %zu\n", slot + 1);
+        exit(1);
+    }
+
+    if (pid == 0) {
+        close(fds[0]);
+        run_fork_worker(queue, slot, tests, num_tests, num_workers, fds[1]);
+    }
+
+    close(fds[1]);
+    worker->pid = pid;
+    worker->fd = fds[0];
+    worker->size = 0;
+}
+
+static void fork_slot_print(
+        struct fork_slot * const slot) {
+    fwrite(slot->report, 1, slot->report_size, stdout);
+    free(slot->report);
+    slot->report = NULL;
+}
+
+// Fails the test a worker died running
+static void report_worker_crash(
+        struct baro__test const * const tests,
+        size_t const position,
+        int const status,
+        struct fork_slot * const slot) {
+    struct baro__test const * const test = &tests[position];
+    struct baro__report * const report = &baro__c.report;
+    baro__report_printf(report, BARO__RED "Test crashed! Worker %s %d\n" BARO__UNSET_COLOR
+                                "  In: %s (%s:%d)\n" BARO__SEPARATOR,
+                        WIFSIGNALED(status) ? "killed by signal" : "exited with status",
+                        WIFSIGNALED(status) ? WTERMSIG(status) : WEXITSTATUS(status),
+                        test->tag->desc, extract_file_name(test->tag->file_path),
+                        test->tag->line_num);
+
+    baro__c.num_tests_ran++;
+    baro__c.num_tests_failed++;
+    baro__c.num_asserts_failed++;
+
+    runner.results[position].num_asserts = 1;
+    runner.results[position].num_asserts_failed = 1;
+    if (runner.results_fd != -1) {
+        record_result(test, &runner.results[position], 1);
+    }
+    if (runner.format != FORMAT_TEXT) {
+        format_result(test, &runner.results[position], 1, position + 1);
+    }
+
+    slot->done = 1;
+    slot->report_size = report->size;
+    slot->report = malloc(report->size);
+    memcpy(slot->report, report->data, report->size);
+    report->size = 0;
+}
+
+// Runs the tests across forked worker processes.
+// Workers pull batches of tests from a shared queue and stream their results
+// back over pipes, which are printed in the original test order. A worker
+// that dies takes only its current test down with it, and is replaced by one
+// that picks up the rest of its batch.
+static void run_tests_in_processes(
+        struct baro__test const * const tests,
+        size_t const num_tests,
+        size_t num_workers) {
+    if (num_workers > num_tests) {
+        num_workers = num_tests;
+    }
+
+    size_t const queue_size = sizeof(struct fork_queue) + num_workers * sizeof(struct fork_worker_state);
+    struct fork_queue * const queue = mmap(NULL, queue_size, PROT_READ | PROT_WRITE,
+                                           MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (queue == MAP_FAILED) {
+        fprintf(stderr, "Failed to map the shared work queue\n");
+        exit(1);
+    }
+    queue->next = 0;
+    queue->stop = 0;
+    for (size_t i = 0; i < num_workers; i++) {
+        queue->workers[i].current = FORK_WORKER_IDLE;
+        queue->workers[i].next = queue->workers[i].end = 0;
+    }
+
+    // Only the workers run tests, so print reports directly from here on
+    baro__redirect_output(&baro__c, 0);
+
+    struct fork_worker * const workers = calloc(num_workers, sizeof(struct fork_worker));
+    struct pollfd * const poll_fds = calloc(num_workers, sizeof(struct pollfd));
+    struct fork_slot * const slots = calloc(num_tests, sizeof(struct fork_slot));
+    size_t next_to_print = 0;
+
+    for (size_t i = 0; i < num_workers; i++) {
+        fork_worker_start(&workers[i], queue, i, tests, num_tests, num_workers);
+    }
+
+    size_t num_alive = num_workers;
+    while (num_alive > 0) {
+        for (size_t i = 0; i < num_workers; i++) {
+            poll_fds[i].fd = workers[i].fd;
+            poll_fds[i].events = POLLIN;
+            poll_fds[i].revents = 0;
+        }
+
+        if (poll(poll_fds, num_workers, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "Failed to poll workers\n");
+            exit(1);
+        }
+
+        for (size_t i = 0; i < num_workers; i++) {
+            struct fork_worker * const worker = &workers[i];
+            if (worker->fd < 0 || !(poll_fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+
+            if (worker->capacity - worker->size < 4096) {
+                worker->capacity = worker->capacity ? worker->capacity * 2 : 8192;
+                worker->buffer = realloc(worker->buffer, worker->capacity);
+            }
+
+            ssize_t const num_read = read(worker->fd, &worker->buffer[worker->size],
+                                          worker->capacity - worker->size);
+            if (num_read < 0 && errno == EINTR) {
+                continue;
+            }
+
+            if (num_read > 0) {
+                worker->size += num_read;
+
+                // Consume every complete result that has arrived
+                size_t offset = 0;
+                struct fork_result result;
+                while (worker->size - offset >= sizeof(result)) {
+                    memcpy(&result, &worker->buffer[offset], sizeof(result));
+                    size_t const leaves_size = result.num_leaves * sizeof(struct leaf_timing);
+                    if (worker->size - offset - sizeof(result) < result.report_size + leaves_size) {
+                        break;
+                    }
+
+                    struct fork_slot * const slot = &slots[result.position];
+                    slot->done = 1;
+                    slot->report_size = result.report_size;
+                    slot->report = malloc(result.report_size);
+                    memcpy(slot->report, &worker->buffer[offset + sizeof(result)], result.report_size);
+
+                    runner.results[result.position].ran = 1;
+                    runner.results[result.position].duration_ns = result.duration_ns;
+                    runner.results[result.position].prefix_ns = result.prefix_ns;
+                    runner.results[result.position].num_passes = result.num_passes;
+                    runner.results[result.position].num_asserts = result.num_asserts;
+                    runner.results[result.position].num_asserts_failed = result.num_asserts_failed;
+                    runner.results[result.position].counters = result.counters;
+                    runner.results[result.position].allocs = result.allocs;
+
+                    for (uint32_t j = 0; j < result.num_leaves; j++) {
+                        struct leaf_timing timing;
+                        memcpy(&timing, &worker->buffer[offset + sizeof(result) + result.report_size +
+                                                         j * sizeof(struct leaf_timing)],
+                               sizeof(timing));
+                        record_leaf(&timing);
+                    }
+
+                    baro__c.num_tests_ran++;
+                    baro__c.num_asserts += result.num_asserts;
+                    baro__c.num_asserts_failed += result.num_asserts_failed;
+                    if (result.failed) {
+                        baro__c.num_tests_failed++;
+                        if (runner.stop_after_failure) {
+                            __atomic_store_n(&queue->stop, 1, __ATOMIC_RELEASE);
+                        }
+                    }
+
+                    offset += sizeof(result) + result.report_size + leaves_size;
+                }
+
+                memmove(worker->buffer, &worker->buffer[offset], worker->size - offset);
+                worker->size -= offset;
+
+                while (next_to_print < num_tests && slots[next_to_print].done) {
+                    fork_slot_print(&slots[next_to_print++]);
+                }
+                continue;
+            }
+
+            // The worker has exited, either because the queue ran dry or
+            // because a test brought it down
+            close(worker->fd);
+            worker->fd = -1;
+            num_alive--;
+
+            int status = 0;
+            waitpid(worker->pid, &status, 0);
+
+            struct fork_worker_state * const state = &queue->workers[i];
+            size_t const position = state->current;
+            state->current = FORK_WORKER_IDLE;
+            if (position != FORK_WORKER_IDLE) {
+                report_worker_crash(tests, position, status, &slots[position]);
+                if (runner.stop_after_failure) {
+                    __atomic_store_n(&queue->stop, 1, __ATOMIC_RELEASE);
+                }
+
+                while (next_to_print < num_tests && slots[next_to_print].done) {
+                    fork_slot_print(&slots[next_to_print++]);
+                }
+            }
+
+            // Replace the worker if there is still work left for it
+            if (!__atomic_load_n(&queue->stop, __ATOMIC_ACQUIRE) &&
+                (state->next < state->end || __atomic_load_n(&queue->next, __ATOMIC_ACQUIRE) < num_tests)) {
+                fork_worker_start(worker, queue, i, tests, num_tests, num_workers);
+                num_alive++;
+            }
+        }
+    }
+    // Tests after a gap left by stopping early are still worth reporting
+    for (; next_to_print < num_tests; next_to_print++) {
+        if (slots[next_to_print].done) {
+            fork_slot_print(&slots[next_to_print]);
+        }
+    }
+
+    for (size_t i = 0; i < num_workers; i++) {
+        free(workers[i].buffer);
+    }
+    free(workers);
+    free(poll_fds);
+    free(slots);
+    munmap(queue, queue_size);
+}
+#endif//_WIN32
+
+// Wall times of previous runs, keyed by "<file name>\t<description>", which
+// are persisted with --durations so that partitions can be balanced by how
+// long their tests actually take
+struct duration_entry {
+    char *key;
+    uint64_t duration_us;
+};
+
+struct duration_table {
+    struct duration_entry *entries;
+    size_t capacity;
+    size_t size;
+};
+
+static uint64_t hash_bytes(
+        char const *data,
+        size_t size) {
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325u;
+    while (size--) {
+        hash ^= (uint8_t) *data++;
+        hash *= 0x100000001b3u;
+    }
+    return hash;
+}
+
+static uint64_t hash_string(
+        char const * const str) {
+    return hash_bytes(str, strlen(str));
+}
+
+static char *duration_key(
+        struct baro__test const * const test) {
+    char const * const file_name = extract_file_name(test->tag->file_path);
+    size_t const size = strlen(file_name) + 1 + strlen(test->tag->desc) + 1;
+
+    char * const key = malloc(size);
+    snprintf(key, size, "%s\t%s", file_name, test->tag->desc);
+    return key;
+}
+
+static struct duration_entry *duration_table_find(
+        struct duration_table * const table,
+        char const * const key) {
+    if (table->capacity == 0) {
+        return NULL;
+    }
+
+    size_t index = hash_string(key) & (table->capacity - 1);
+    while (table->entries[index].key) {
+        if (strcmp(table->entries[index].key, key) == 0) {
+            return &table->entries[index];
+        }
+        index = (index + 1) & (table->capacity - 1);
+    }
+    return NULL;
+}
+
+// Sets the duration of a test, taking ownership of the key
+static void duration_table_set(
+        struct duration_table * const table,
+        char * const key,
+        uint64_t const duration_us) {
+    struct duration_entry * const existing = duration_table_find(table, key);
+    if (existing) {
+        existing->duration_us = duration_us;
+        free(key);
+        return;
+    }
+
+    if ((table->size + 1) * 4 > table->capacity * 3) {
+        struct duration_entry * const old_entries = table->entries;
+        size_t const old_capacity = table->capacity;
+
+        table->capacity = old_capacity ? old_capacity * 2 : 64;
+        table->entries = calloc(table->capacity, sizeof(struct duration_entry));
+        table->size = 0;
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (old_entries[i].key) {
+                duration_table_set(table, old_entries[i].key, old_entries[i].duration_us);
+            }
+        }
+        free(old_entries);
+    }
+
+    size_t index = hash_string(key) & (table->capacity - 1);
+    while (table->entries[index].key) {
+        index = (index + 1) & (table->capacity - 1);
+    }
+    table->entries[index].key = key;
+    table->entries[index].duration_us = duration_us;
+    table->size++;
+}
+
+static void duration_table_destroy(
+        struct duration_table * const table) {
+    for (size_t i = 0; i < table->capacity; i++) {
+        free(table->entries[i].key);
+    }
+    free(table->entries);
+}
+
+// Reads a whole line of any length, without the trailing newline
+static int read_line(
+        FILE * const file,
+        char ** const line,
+        size_t * const capacity) {
+    size_t size = 0;
+    while (1) {
+        if (*capacity - size < 2) {
+            *capacity = *capacity ? *capacity * 2 : 256;
+            *line = realloc(*line, *capacity);
+        }
+
+        if (!fgets(&(*line)[size], (int) (*capacity - size), file)) {
+            return size > 0;
+        }
+
+        size += strlen(&(*line)[size]);
+        if (size > 0 && (*line)[size - 1] == '\n') {
+            (*line)[--size] = '\0';
+            if (size > 0 && (*line)[size - 1] == '\r') {
+                (*line)[--size] = '\0';
+            }
+            return 1;
+        }
+    }
+}
+
+// Loads a durations file written by a previous run. Files from several
+// partitions can simply be concatenated, in which case later lines win.
+static int duration_table_load(
+        struct duration_table * const table,
+        char const * const path) {
+    FILE * const file = fopen(path, "r");
+    if (file == NULL) {
+        return 0;
+    }
+
+    char *line = NULL;
+    size_t capacity = 0;
+    while (read_line(file, &line, &capacity)) {
+        char *key;
+        unsigned long long const duration_us = strtoull(line, &key, 10);
+        if (key == line || *key++ != '\t' || strchr(key, '\t') == NULL) {
+            continue;
+        }
+
+#ifdef _WIN32
+        duration_table_set(table, _strdup(key), duration_us);
+#else
+        duration_table_set(table, strdup(key), duration_us);
+#endif
+    }
+
+    free(line);
+    fclose(file);
+    return 1;
+}
+
+static int duration_entry_cmp(
+        void const *lhs,
+        void const *rhs) {
+    struct duration_entry const * const lhs_entry = lhs;
+    struct duration_entry const * const rhs_entry = rhs;
+    return strcmp(lhs_entry->key, rhs_entry->key);
+}
+
+static void duration_entry_write(
+        FILE * const file,
+        void const * const entry) {
+    struct duration_entry const * const duration = entry;
+    fprintf(file, "%llu\t%s\n", (unsigned long long) duration->duration_us, duration->key);
+}
+
+// Writes the entries of a table to a file, one at a time through
+// `write_entry`, in the order given by `compare`. Entries are written in a
+// stable order so that the file diffs nicely. Slots whose pointer at
+// `key_offset` isn't set are empty, and are left out.
+static int save_sorted_entries(
+        char const * const path,
+        void const * const entries,
+        size_t const num_slots,
+        size_t const entry_size,
+        size_t const key_offset,
+        int (* const compare)(void const *, void const *),
+        void (* const write_entry)(FILE *, void const *)) {
+    FILE * const file = fopen(path, "w");
+    if (file == NULL) {
+        return 0;
+    }
+
+    char * const sorted = calloc(num_slots + 1, entry_size);
+    size_t num_entries = 0;
+    for (size_t i = 0; i < num_slots; i++) {
+        char const * const entry = (char const *) entries + i * entry_size;
+        void *key;
+        memcpy(&key, entry + key_offset, sizeof(key));
+        if (key != NULL) {
+            memcpy(sorted + num_entries++ * entry_size, entry, entry_size);
+        }
+    }
+    qsort(sorted, num_entries, entry_size, compare);
+
+    for (size_t i = 0; i < num_entries; i++) {
+        write_entry(file, sorted + i * entry_size);
+    }
+
+    free(sorted);
+    return fclose(file) == 0;
+}
+
+static int duration_table_save(
+        struct duration_table * const table,
+        char const * const path) {
+    return save_sorted_entries(path, table->entries, table->capacity, sizeof(struct duration_entry),
+                               offsetof(struct duration_entry, key), duration_entry_cmp, duration_entry_write);
+}
+
+// Tag expressions given with -t, such as "(net | disk) & !flaky". Tags are
+// written bare or in brackets, and "," is another way of writing "|". The
+// expression is compiled once into a small stack program over sets of tests.
+enum tag_op {
+    TAG_OP_TAG,
+    TAG_OP_NOT,
+    TAG_OP_AND,
+    TAG_OP_OR,
+};
+
+struct tag_instr {
+    enum tag_op op;
+    size_t tag_id;
+};
+
+struct tag_name {
+    char const *name;
+    size_t size;
+};
+
+struct tag_expr {
+    struct tag_instr *instrs;
+    size_t num_instrs;
+    // Only the tags named in the expression are interned, since no other tag
+    // can change its outcome
+    struct tag_name *tags;
+    size_t num_tags;
+    size_t max_depth;
+    int names_hidden;
+
+    char const *source;
+    char const *p;
+    char const *error;
+};
+
+static void tag_expr_emit(
+        struct tag_expr * const expr,
+        enum tag_op const op,
+        size_t const tag_id) {
+    expr->instrs[expr->num_instrs].op = op;
+    expr->instrs[expr->num_instrs].tag_id = tag_id;
+    expr->num_instrs++;
+}
+
+static size_t tag_expr_intern(
+        struct tag_expr * const expr,
+        char const * const name,
+        size_t const size) {
+    for (size_t i = 0; i < expr->num_tags; i++) {
+        if (expr->tags[i].size == size && memcmp(expr->tags[i].name, name, size) == 0) {
+            return i;
+        }
+    }
+
+    expr->tags[expr->num_tags].name = name;
+    expr->tags[expr->num_tags].size = size;
+    return expr->num_tags++;
+}
+
+static void tag_expr_skip_whitespace(
+        struct tag_expr * const expr) {
+    while (*expr->p == ' ' || *expr->p == '\t' || *expr->p == '\n' || *expr->p == '\r') {
+        expr->p++;
+    }
+}
+
+static int tag_expr_parse_or(struct tag_expr *expr);
+
+static int tag_expr_parse_unary(
+        struct tag_expr * const expr) {
+    tag_expr_skip_whitespace(expr);
+
+    if (*expr->p == '!') {
+        expr->p++;
+        if (!tag_expr_parse_unary(expr)) {
+            return 0;
+        }
+        tag_expr_emit(expr, TAG_OP_NOT, 0);
+        return 1;
+    }
+
+    if (*expr->p == '(') {
+        expr->p++;
+        if (!tag_expr_parse_or(expr)) {
+            return 0;
+        }
+        tag_expr_skip_whitespace(expr);
+        if (*expr->p != ')') {
+            expr->error = "expected ')'";
+            return 0;
+        }
+        expr->p++;
+        return 1;
+    }
+
+    char const *name = expr->p;
+    char const *end;
+    if (*expr->p == '[') {
+        name++;
+        end = strchr(name, ']');
+        if (end == NULL) {
+            expr->error = "expected ']'";
+            return 0;
+        }
+        expr->p = end + 1;
+    } else {
+        while (*expr->p && strchr("&|!(),[]", *expr->p) == NULL) {
+            expr->p++;
+        }
+        end = expr->p;
+        while (end > name && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\n' || end[-1] == '\r')) {
+            end--;
+        }
+    }
+
+    if (end == name) {
+        expr->error = "expected a tag";
+        return 0;
+    }
+
+    size_t const size = (size_t) (end - name);
+    if (size == 1 && name[0] == '.') {
+        expr->names_hidden = 1;
+    }
+
+    tag_expr_emit(expr, TAG_OP_TAG, tag_expr_intern(expr, name, size));
+    expr->max_depth++;
+    return 1;
+}
+
+static int tag_expr_parse_and(
+        struct tag_expr * const expr) {
+    if (!tag_expr_parse_unary(expr)) {
+        return 0;
+    }
+
+    for (;;) {
+        tag_expr_skip_whitespace(expr);
+        if (*expr->p != '&') {
+            return 1;
+        }
+
+        expr->p++;
+        if (!tag_expr_parse_unary(expr)) {
+            return 0;
+        }
+        tag_expr_emit(expr, TAG_OP_AND, 0);
+    }
+}
+
+static int tag_expr_parse_or(
+        struct tag_expr * const expr) {
+    if (!tag_expr_parse_and(expr)) {
+        return 0;
+    }
+
+    for (;;) {
+        tag_expr_skip_whitespace(expr);
+        if (*expr->p != '|' && *expr->p != ',') {
+            return 1;
+        }
+
+        expr->p++;
+        if (!tag_expr_parse_and(expr)) {
+            return 0;
+        }
+        tag_expr_emit(expr, TAG_OP_OR, 0);
+    }
+}
+
+// Compiles an expression, which has to outlive it. Returns zero on error, in
+// which case `error` and `p` tell what went wrong and where.
+static int tag_expr_compile(
+        struct tag_expr * const expr,
+        char const * const source) {
+    // Every tag and operator takes up at least one character
+    size_t const max_size = strlen(source) + 1;
+
+    *expr = (struct tag_expr){0};
+    expr->instrs = malloc(max_size * sizeof(struct tag_instr));
+    expr->tags = malloc(max_size * sizeof(struct tag_name));
+    expr->source = source;
+    expr->p = source;
+
+    if (!tag_expr_parse_or(expr)) {
+        return 0;
+    }
+
+    tag_expr_skip_whitespace(expr);
+    if (*expr->p != '\0') {
+        expr->error = "unexpected character";
+        return 0;
+    }
+    return 1;
+}
+
+static void tag_expr_destroy(
+        struct tag_expr * const expr) {
+    free(expr->instrs);
+    free(expr->tags);
+}
+
+// Finds the next [tag] in a test description, and moves past it
+static char const *next_tag(
+        char const ** const p,
+        size_t * const size) {
+    char const * const open = strchr(*p, '[');
+    char const * const close = open != NULL ? strchr(open + 1, ']') : NULL;
+    if (close == NULL) {
+        return NULL;
+    }
+
+    *p = close + 1;
+    *size = (size_t) (close - open - 1);
+    return open + 1;
+}
+
+static int is_hidden(
+        struct baro__test const * const test) {
+    char const *p = test->tag->desc;
+    char const *name;
+    size_t size;
+    while ((name = next_tag(&p, &size)) != NULL) {
+        if (size == 1 && name[0] == '.') {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Selects the tests that match an expression, or every test without one.
+// Hidden tests, tagged with [.], are left out unless `include_hidden` is set,
+// and only benchmarks are selected when `benches` is set, or only tests.
+// The tags of every test are parsed once into a bitset over all tests per
+// tag, so that the expression is then evaluated for 64 tests at a time.
+// When every test is selected, `selected` shares the tests of `all` rather
+// than copying them.
+static void select_tests(
+        struct tag_expr const * const expr,
+        int const include_hidden,
+        int const benches,
+        struct baro__test_list const * const all,
+        struct baro__test_list * const selected) {
+    if (expr == NULL) {
+        size_t i = 0;
+        while (i < all->size && all->tests[i].bench == benches && (include_hidden || !is_hidden(&all->tests[i]))) {
+            i++;
+        }
+        if (i == all->size) {
+            *selected = *all;
+            return;
+        }
+    }
+
+    size_t const num_words = (all->size + 63) / 64;
+    size_t const num_tags = expr != NULL ? expr->num_tags : 0;
+
+    // Maps tag names to their id plus one
+    size_t capacity = 16;
+    while (capacity < num_tags * 2) {
+        capacity *= 2;
+    }
+    size_t * const slots = calloc(capacity, sizeof(size_t));
+    for (size_t id = 0; id < num_tags; id++) {
+        size_t slot = hash_bytes(expr->tags[id].name, expr->tags[id].size) & (capacity - 1);
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        slots[slot] = id + 1;
+    }
+
+    // One bitset per tag in the expression, followed by the hidden tests
+    uint64_t * const columns = calloc((num_tags + 1) * num_words, sizeof(uint64_t));
+    uint64_t * const hidden = columns + num_tags * num_words;
+
+    for (size_t i = 0; i < all->size; i++) {
+        size_t const word = i / 64;
+        uint64_t const bit = (uint64_t) 1 << (i % 64);
+
+        char const *p = all->tests[i].tag->desc;
+        char const *name;
+        size_t size;
+        while ((name = next_tag(&p, &size)) != NULL) {
+            if (size == 1 && name[0] == '.') {
+                hidden[word] |= bit;
+            }
+
+            size_t slot = hash_bytes(name, size) & (capacity - 1);
+            while (slots[slot] != 0) {
+                struct tag_name const * const tag = &expr->tags[slots[slot] - 1];
+                if (tag->size == size && memcmp(tag->name, name, size) == 0) {
+                    columns[(slots[slot] - 1) * num_words + word] |= bit;
+                    break;
+                }
+                slot = (slot + 1) & (capacity - 1);
+            }
+        }
+    }
+
+    size_t const max_depth = expr != NULL && expr->max_depth > 0 ? expr->max_depth : 1;
+    uint64_t * const stack = malloc(max_depth * num_words * sizeof(uint64_t));
+    if (expr != NULL) {
+        size_t top = 0;
+        for (size_t i = 0; i < expr->num_instrs; i++) {
+            struct tag_instr const * const instr = &expr->instrs[i];
+
+            switch (instr->op) {
+            case TAG_OP_TAG:
+                memcpy(stack + top * num_words, columns + instr->tag_id * num_words,
+                       num_words * sizeof(uint64_t));
+                top++;
+                break;
+
+            case TAG_OP_NOT:
+                for (size_t w = 0; w < num_words; w++) {
+                    stack[(top - 1) * num_words + w] = ~stack[(top - 1) * num_words + w];
+                }
+                break;
+
+            case TAG_OP_AND:
+                top--;
+                for (size_t w = 0; w < num_words; w++) {
+                    stack[(top - 1) * num_words + w] &= stack[top * num_words + w];
+                }
+                break;
+
+            case TAG_OP_OR:
+                top--;
+                for (size_t w = 0; w < num_words; w++) {
+                    stack[(top - 1) * num_words + w] |= stack[top * num_words + w];
+                }
+                break;
+            }
+        }
+    } else {
+        memset(stack, 0xff, num_words * sizeof(uint64_t));
+    }
+
+    if (!include_hidden) {
+        for (size_t w = 0; w < num_words; w++) {
+            stack[w] &= ~hidden[w];
+        }
+    }
+
+    baro__test_list_create(selected, all->size > 0 ? all->size : 1);
+    for (size_t i = 0; i < all->size; i++) {
+        if ((stack[i / 64] & ((uint64_t) 1 << (i % 64))) && all->tests[i].bench == benches) {
+            baro__test_list_add(selected, &all->tests[i]);
+        }
+    }
+
+    free(stack);
+    free(columns);
+    free(slots);
+}
+
+// Stable IDs for addressing tests from outside, such as by a scheduler that
+// hands out tests with --ids. An ID only depends on the file name and the
+// description of a test, so that adding or moving tests leaves every other ID
+// alone. Tests sharing both are told apart by their line number.
+static uint64_t hash_string_mixed(
+        uint64_t hash,
+        char const *str) {
+    // Read a byte at a time rather than whole words, so that IDs don't depend
+    // on the byte order of the machine
+    uint64_t word = 0;
+    unsigned shift = 0;
+    while (*str) {
+        word |= (uint64_t) (uint8_t) *str++ << shift;
+        shift += 8;
+        if (shift == 64) {
+            hash = baro__mix64(hash ^ word);
+            word = 0;
+            shift = 0;
+        }
+    }
+    return baro__mix64(hash ^ word ^ (uint64_t) (shift / 8 + 1) << 56u);
+}
+
+// The IDs of every test, keyed by the address of its tag
+struct test_ids {
+    struct baro__tag const **tags;
+    uint64_t *ids;
+    size_t capacity;
+};
+
+static size_t test_ids_slot(
+        struct test_ids const * const table,
+        struct baro__tag const * const tag) {
+    size_t slot = (size_t) baro__mix64((uint64_t) (uintptr_t) tag) & (table->capacity - 1);
+    while (table->tags[slot] != NULL && table->tags[slot] != tag) {
+        slot = (slot + 1) & (table->capacity - 1);
+    }
+    return slot;
+}
+
+// Computes the IDs of all tests. They are told apart by line number only when
+// needed, which takes every test into account, so IDs are always computed for
+// the whole suite rather than for whatever has been filtered out of it.
+static void test_ids_create(
+        struct test_ids * const table,
+        struct baro__test_list const * const tests) {
+    size_t const size = tests->size;
+    uint64_t * const keys = malloc((size + 1) * sizeof(uint64_t));
+    size_t * const indices = malloc((size + 1) * sizeof(size_t));
+    for (size_t i = 0; i < size; i++) {
+        uint64_t const hash = hash_string_mixed(0, extract_file_name(tests->tests[i].tag->file_path));
+        keys[i] = hash_string_mixed(hash, tests->tests[i].tag->desc);
+        indices[i] = i;
+    }
+
+    table->capacity = 16;
+    while (table->capacity < size * 2) {
+        table->capacity *= 2;
+    }
+    table->tags = calloc(table->capacity, sizeof(struct baro__tag const *));
+    table->ids = malloc(table->capacity * sizeof(uint64_t));
+
+    // Sorting brings the tests that share an ID next to each other
+    baro__radix_sort(keys, indices, size);
+    for (size_t i = 0; i < size; i++) {
+        struct baro__tag const * const tag = tests->tests[indices[i]].tag;
+        uint64_t id = keys[i];
+        if ((i > 0 && keys[i - 1] == id) || (i + 1 < size && keys[i + 1] == id)) {
+            id = baro__mix64(id ^ (uint64_t) tag->line_num);
+        }
+
+        size_t const slot = test_ids_slot(table, tag);
+        table->tags[slot] = tag;
+        table->ids[slot] = id;
+    }
+
+    free(indices);
+    free(keys);
+}
+
+static uint64_t test_ids_find(
+        struct test_ids const * const table,
+        struct baro__tag const * const tag) {
+    return table->ids[test_ids_slot(table, tag)];
+}
+
+static void test_ids_destroy(
+        struct test_ids * const table) {
+    free(table->tags);
+    free(table->ids);
+}
+
+// A set of test IDs read from a file given with --ids, which also remembers
+// which of them matched a test
+struct test_id_set {
+    uint64_t *ids;
+    unsigned char *states;
+    size_t capacity;
+    size_t size;
+};
+
+enum {
+    TEST_ID_EMPTY,
+    TEST_ID_UNMATCHED,
+    TEST_ID_MATCHED,
+};
+
+static size_t test_id_set_slot(
+        struct test_id_set const * const set,
+        uint64_t const id) {
+    size_t slot = (size_t) baro__mix64(id) & (set->capacity - 1);
+    while (set->states[slot] != TEST_ID_EMPTY && set->ids[slot] != id) {
+        slot = (slot + 1) & (set->capacity - 1);
+    }
+    return slot;
+}
+
+static void test_id_set_add(
+        struct test_id_set * const set,
+        uint64_t const id) {
+    if ((set->size + 1) * 2 > set->capacity) {
+        struct test_id_set const old = *set;
+
+        set->capacity = old.capacity ? old.capacity * 2 : 64;
+        set->ids = malloc(set->capacity * sizeof(uint64_t));
+        set->states = calloc(set->capacity, 1);
+        for (size_t i = 0; i < old.capacity; i++) {
+            if (old.states[i] != TEST_ID_EMPTY) {
+                size_t const slot = test_id_set_slot(set, old.ids[i]);
+                set->ids[slot] = old.ids[i];
+                set->states[slot] = old.states[i];
+            }
+        }
+        free(old.ids);
+        free(old.states);
+    }
+
+    size_t const slot = test_id_set_slot(set, id);
+    if (set->states[slot] == TEST_ID_EMPTY) {
+        set->ids[slot] = id;
+        set->states[slot] = TEST_ID_UNMATCHED;
+        set->size++;
+    }
+}
+
+// Marks an ID as matched, returning whether it is in the set at all
+static int test_id_set_match(
+        struct test_id_set * const set,
+        uint64_t const id) {
+    if (set->capacity == 0) {
+        return 0;
+    }
+
+    size_t const slot = test_id_set_slot(set, id);
+    if (set->states[slot] == TEST_ID_EMPTY) {
+        return 0;
+    }
+    set->states[slot] = TEST_ID_MATCHED;
+    return 1;
+}
+
+static void test_id_set_destroy(
+        struct test_id_set * const set) {
+    free(set->ids);
+    free(set->states);
+}
+
+// Loads a file with a test ID at the start of each line, so that the output of
+// --list can be filtered and passed in as it is. Blank lines and lines starting
+// with '#' are skipped.
+static int test_id_set_load(
+        struct test_id_set * const set,
+        char const * const path) {
+    FILE * const file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open test IDs from %s\n", path);
+        return 0;
+    }
+
+    char *line = NULL;
+    size_t capacity = 0;
+    size_t line_num = 0;
+    int ok = 1;
+    while (ok && read_line(file, &line, &capacity)) {
+        line_num++;
+
+        char const *p = line;
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        if (*p == '\0' || *p == '#') {
+            continue;
+        }
+
+        char *end;
+        unsigned long long const id = strtoull(p, &end, 16);
+        if (end == p || (*end != '\0' && *end != ' ' && *end != '\t')) {
+            fprintf(stderr, "Invalid test ID on line %zu of %s\n", line_num, path);
+            ok = 0;
+            break;
+        }
+        test_id_set_add(set, id);
+    }
+
+    free(line);
+    fclose(file);
+    return ok;
+}
+
+// Appends text, escaped for where it ends up in a result of the given format
+static void format_escaped(
+        struct baro__report * const out,
+        enum result_format const format,
+        char const * const text,
+        size_t const size) {
+    for (size_t i = 0; i < size; i++) {
+        unsigned char const c = (unsigned char) text[i];
+        char const *escape = NULL;
+        char code[8];
+
+        switch (format) {
+        case FORMAT_JSONL:
+            if (c == '"') {
+                escape = "\\\"";
+            } else if (c == '\\') {
+                escape = "\\\\";
+            } else if (c == '\n') {
+                escape = "\\n";
+            } else if (c == '\r') {
+                escape = "\\r";
+            } else if (c == '\t') {
+                escape = "\\t";
+            } else if (c < 0x20) {
+                snprintf(code, sizeof(code), "\\u%04x", c);
+                escape = code;
+            }
+            break;
+
+        case FORMAT_JUNIT:
+            if (c == '&') {
+                escape = "&amp;";
+            } else if (c == '<') {
+                escape = "&lt;";
+            } else if (c == '>') {
+                escape = "&gt;";
+            } else if (c == '"') {
+                escape = "&quot;";
+            } else if (c < 0x20 && c != '\n' && c != '\r' && c != '\t') {
+                // Not even allowed as a character reference in XML 1.0
+                escape = "?";
+            }
+            break;
+
+        case FORMAT_TAP:
+            // Every line of a block is indented under its key
+            if (c == '\n' && i + 1 < size) {
+                escape = "\n    ";
+            }
+            break;
+
+        case FORMAT_TEXT:
+            break;
+        }
+
+        if (escape != NULL) {
+            size_t const escape_size = strlen(escape);
+            memcpy(baro__report_reserve(out, escape_size), escape, escape_size);
+            out->size += escape_size;
+        } else {
+            *baro__report_reserve(out, 1) = (char) c;
+            out->size++;
+        }
+    }
+}
+
+static void format_string(
+        struct baro__report * const out,
+        enum result_format const format,
+        char const * const str) {
+    format_escaped(out, format, str, strlen(str));
+}
+
+// Appends a block of text to a TAP result, under the given key
+static void format_tap_block(
+        struct baro__report * const out,
+        char const * const key,
+        char const * const text,
+        size_t const size) {
+    if (size == 0) {
+        return;
+    }
+
+    // The indentation is given up front, as the text may start with spaces
+    baro__report_printf(out, "  %s: |2\n    ", key);
+    format_escaped(out, FORMAT_TAP, text, size);
+    if (text[size - 1] != '\n') {
+        baro__report_printf(out, "\n");
+    }
+}
+
+// Writes the counters that are available, each divided by `divisor`: as an
+// object in JSON, as properties whose names start with `prefix` in JUnit, and
+// as a mapping indented by `prefix` in TAP
+static void format_counter_values(
+        struct baro__report * const out,
+        char const * const prefix,
+        struct counters const * const counters,
+        double const divisor) {
+    char const * const number = divisor == 1 ? "%.0f" : "%.3f";
+    for (size_t i = 0, first = 1; i < BARO__NUM_COUNTERS; i++) {
+        if (!(counters->available & (1u << i))) {
+            continue;
+        }
+
+        double const value = (double) counters->values[i] / divisor;
+        switch (runner.format) {
+        case FORMAT_JSONL:
+            baro__report_printf(out, "%s\"%s\":", first ? "{" : ",", counter_keys[i]);
+            break;
+        case FORMAT_JUNIT:
+            baro__report_printf(out, "      <property name=\"%s%s\" value=\"", prefix, counter_keys[i]);
+            break;
+        case FORMAT_TAP:
+            baro__report_printf(out, "%s%s: ", prefix, counter_keys[i]);
+            break;
+        case FORMAT_TEXT:
+            return;
+        }
+        baro__report_printf(out, number, value);
+        baro__report_printf(out, runner.format == FORMAT_JUNIT ? "\"/>\n" : runner.format == FORMAT_TAP ? "\n" : "");
+        first = 0;
+    }
+
+    if (runner.format == FORMAT_JSONL) {
+        baro__report_printf(out, counters->available ? "}" : "{}");
+    }
+}
+
+// Replaces the reports of a finished test with its result in the format being
+// written, carrying those reports along with the test's captured output
+static void format_result(
+        struct baro__test const * const test,
+        struct test_result const * const result,
+        int const failed,
+        size_t const number) {
+    struct baro__report * const report = &baro__c.report;
+    size_t const report_size = report->size;
+    size_t const output_size = baro__append_output(&baro__c, report);
+    char const * const output = output_size > 0 ? report->data + report_size : "";
+
+    struct baro__tag const * const tag = test->tag;
+    char const * const file_name = extract_file_name(tag->file_path);
+    unsigned long long const id = test_ids_find(runner.ids, tag);
+
+    struct baro__report * const out = &formatted_result;
+    char const *p = tag->desc;
+    char const *name;
+    size_t size;
+
+    struct bench_stats stats = {0};
+    if (result->bench_num_samples > 0) {
+        bench_stats_compute(&stats, result->bench_samples, result->bench_num_samples);
+    }
+    double const bench_divisor = (double) result->bench_num_samples * result->bench_iterations;
+
+    switch (runner.format) {
+    case FORMAT_JSONL:
+        baro__report_printf(out, "{\"type\":\"test\",\"id\":\"%016llx\",\"file\":\"", id);
+        format_string(out, FORMAT_JSONL, file_name);
+        baro__report_printf(out, "\",\"line\":%d,\"name\":\"", tag->line_num);
+        format_string(out, FORMAT_JSONL, tag->desc);
+        baro__report_printf(out, "\",\"tags\":[");
+        for (int first = 1; (name = next_tag(&p, &size)) != NULL; first = 0) {
+            baro__report_printf(out, first ? "\"" : ",\"");
+            format_escaped(out, FORMAT_JSONL, name, size);
+            baro__report_printf(out, "\"");
+        }
+        baro__report_printf(out, "],\"status\":\"%s\",\"duration_ns\":%llu,\"asserts\":%zu,"
+                                 "\"asserts_failed\":%zu,",
+                            failed ? "failed" : "passed", (unsigned long long) result->duration_ns,
+                            result->num_asserts, result->num_asserts_failed);
+        if (result->counters.available) {
+            baro__report_printf(out, "\"counters\":");
+            format_counter_values(out, "", &result->counters, 1);
+            baro__report_printf(out, ",");
+        }
+        if (result->allocs.tracked) {
+            baro__report_printf(out, "\"allocs\":{\"count\":%llu,\"bytes\":%llu,\"peak_bytes\":%llu,"
+                                     "\"leaked\":%llu,\"leaked_bytes\":%llu},",
+                                (unsigned long long) result->allocs.count,
+                                (unsigned long long) result->allocs.bytes,
+                                (unsigned long long) result->allocs.peak_bytes,
+                                (unsigned long long) result->allocs.leaked,
+                                (unsigned long long) result->allocs.leaked_bytes);
+        }
+        if (result->bench_num_samples > 0) {
+            baro__report_printf(out, "\"bench\":{\"median_ns\":%.3f,\"mad_ns\":%.3f,\"min_ns\":%.3f,"
+                                     "\"samples\":%zu,\"iterations\":%zu",
+                                stats.median_ns, stats.mad_ns, stats.min_ns,
+                                result->bench_num_samples, result->bench_iterations);
+            if (result->bench_counters.available) {
+                baro__report_printf(out, ",\"counters\":");
+                format_counter_values(out, "", &result->bench_counters, bench_divisor);
+            }
+            if (result->bench_compared) {
+                baro__report_printf(out, ",\"baseline_ns\":%.3f,\"p_value\":%.6g",
+                                    result->bench_baseline_ns, result->bench_p_value);
+            }
+            if (result->bench_renamed_from != NULL) {
+                baro__report_printf(out, ",\"baseline_name\":\"");
+                format_string(out, FORMAT_JSONL, result->bench_renamed_from);
+                baro__report_printf(out, "\"");
+            }
+            baro__report_printf(out, "},");
+        }
+        baro__report_printf(out, "\"report\":\"");
+        format_escaped(out, FORMAT_JSONL, report->data, report_size);
+        baro__report_printf(out, "\",\"output\":\"");
+        format_escaped(out, FORMAT_JSONL, output, output_size);
+        baro__report_printf(out, "\"}\n");
+        break;
+
+    case FORMAT_JUNIT:
+        baro__report_printf(out, "  <testcase classname=\"");
+        format_string(out, FORMAT_JUNIT, file_name);
+        baro__report_printf(out, "\" name=\"");
+        format_string(out, FORMAT_JUNIT, tag->desc);
+        baro__report_printf(out, "\" file=\"");
+        format_string(out, FORMAT_JUNIT, file_name);
+        baro__report_printf(out, "\" line=\"%d\" time=\"%.6f\">\n", tag->line_num, result->duration_ns / 1e9);
+
+        baro__report_printf(out, "    <properties>\n"
+                                 "      <property name=\"id\" value=\"%016llx\"/>\n", id);
+        baro__report_printf(out, "      <property name=\"tags\" value=\"");
+        for (int first = 1; (name = next_tag(&p, &size)) != NULL; first = 0) {
+            baro__report_printf(out, first ? "" : " ");
+            format_escaped(out, FORMAT_JUNIT, name, size);
+        }
+        baro__report_printf(out, "\"/>\n"
+                                 "      <property name=\"asserts\" value=\"%zu\"/>\n"
+                                 "      <property name=\"asserts_failed\" value=\"%zu\"/>\n",
+                            result->num_asserts, result->num_asserts_failed);
+        if (result->bench_num_samples > 0) {
+            baro__report_printf(out, "      <property name=\"bench_median_ns\" value=\"%.3f\"/>\n"
+                                     "      <property name=\"bench_mad_ns\" value=\"%.3f\"/>\n"
+                                     "      <property name=\"bench_min_ns\" value=\"%.3f\"/>\n"
+                                     "      <property name=\"bench_samples\" value=\"%zu\"/>\n"
+                                     "      <property name=\"bench_iterations\" value=\"%zu\"/>\n",
+                                stats.median_ns, stats.mad_ns, stats.min_ns,
+                                result->bench_num_samples, result->bench_iterations);
+            format_counter_values(out, "bench_", &result->bench_counters, bench_divisor);
+        }
+        format_counter_values(out, "", &result->counters, 1);
+        if (result->allocs.tracked) {
+            baro__report_printf(out, "      <property name=\"allocs\" value=\"%llu\"/>\n"
+                                     "      <property name=\"alloc_bytes\" value=\"%llu\"/>\n"
+                                     "      <property name=\"alloc_peak_bytes\" value=\"%llu\"/>\n"
+                                     "      <property name=\"leaked\" value=\"%llu\"/>\n"
+                                     "      <property name=\"leaked_bytes\" value=\"%llu\"/>\n",
+                                (unsigned long long) result->allocs.count,
+                                (unsigned long long) result->allocs.bytes,
+                                (unsigned long long) result->allocs.peak_bytes,
+                                (unsigned long long) result->allocs.leaked,
+                                (unsigned long long) result->allocs.leaked_bytes);
+        }
+        if (result->bench_compared) {
+            baro__report_printf(out, "      <property name=\"bench_baseline_ns\" value=\"%.3f\"/>\n"
+                                     "      <property name=\"bench_p_value\" value=\"%.6g\"/>\n",
+                                result->bench_baseline_ns, result->bench_p_value);
+        }
+        baro__report_printf(out, "    </properties>\n");
+
+        if (failed) {
+            baro__report_printf(out, "    <failure message=\"%zu of %zu assertions failed\">",
+                                result->num_asserts_failed, result->num_asserts);
+            format_escaped(out, FORMAT_JUNIT, report->data, report_size);
+            baro__report_printf(out, "</failure>\n");
+        }
+        if (output_size > 0) {
+            baro__report_printf(out, "    <system-out>");
+            format_escaped(out, FORMAT_JUNIT, output, output_size);
+            baro__report_printf(out, "</system-out>\n");
+        }
+        baro__report_printf(out, "  </testcase>\n");
+        break;
+
+    case FORMAT_TAP:
+        // Tests are numbered by their place in the run, whichever order they
+        // finish in. A '#' would start a directive.
+        baro__report_printf(out, "%s %zu - ", failed ? "not ok" : "ok", number);
+        for (char const *c = tag->desc; *c; c++) {
+            baro__report_printf(out, *c == '#' ? "\\%c" : "%c", *c);
+        }
+
+        baro__report_printf(out, "\n  ---\n  id: \"%016llx\"\n  file: \"", id);
+        format_string(out, FORMAT_JSONL, file_name);
+        baro__report_printf(out, "\"\n  line: %d\n  tags: [", tag->line_num);
+        for (int first = 1; (name = next_tag(&p, &size)) != NULL; first = 0) {
+            baro__report_printf(out, first ? "\"" : ", \"");
+            format_escaped(out, FORMAT_JSONL, name, size);
+            baro__report_printf(out, "\"");
+        }
+        baro__report_printf(out, "]\n  duration_ms: %.3f\n  asserts: %zu\n  asserts_failed: %zu\n",
+                            result->duration_ns / 1e6, result->num_asserts, result->num_asserts_failed);
+        if (result->counters.available) {
+            baro__report_printf(out, "  counters:\n");
+            format_counter_values(out, "    ", &result->counters, 1);
+        }
+        if (result->allocs.tracked) {
+            baro__report_printf(out, "  allocs:\n    count: %llu\n    bytes: %llu\n    peak_bytes: %llu\n"
+                                     "    leaked: %llu\n    leaked_bytes: %llu\n",
+                                (unsigned long long) result->allocs.count,
+                                (unsigned long long) result->allocs.bytes,
+                                (unsigned long long) result->allocs.peak_bytes,
+                                (unsigned long long) result->allocs.leaked,
+                                (unsigned long long) result->allocs.leaked_bytes);
+        }
+        if (result->bench_num_samples > 0) {
+            baro__report_printf(out, "  bench:\n    median_ns: %.3f\n    mad_ns: %.3f\n    min_ns: %.3f\n"
+                                     "    samples: %zu\n    iterations: %zu\n",
+                                stats.median_ns, stats.mad_ns, stats.min_ns,
+                                result->bench_num_samples, result->bench_iterations);
+            if (result->bench_counters.available) {
+                baro__report_printf(out, "    counters:\n");
+                format_counter_values(out, "      ", &result->bench_counters, bench_divisor);
+            }
+        }
+        if (result->bench_compared) {
+            baro__report_printf(out, "    baseline_ns: %.3f\n    p_value: %.6g\n",
+                                result->bench_baseline_ns, result->bench_p_value);
+        }
+        format_tap_block(out, "report", report->data, report_size);
+        format_tap_block(out, "output", output, output_size);
+        baro__report_printf(out, "  ...\n");
+        break;
+
+    case FORMAT_TEXT:
+        return;
+    }
+
+    struct baro__report const formatted = *out;
+    *out = *report;
+    out->size = 0;
+    *report = formatted;
+}
+
+// Exit statuses, so that a script can tell failing tests apart from a run that
+// couldn't get started
+enum {
+    EXIT_PASSED = 0,
+    EXIT_FAILED = 1,
+    EXIT_ERROR = 2,
+};
+
+// Results files, written with --results by each shard of a partitioned run and
+// read back with --merge. They start with RESULTS_MAGIC, followed by a record
+// per test in the order the tests finished, each followed by `report_size`
+// bytes of the report that text would show for it. An end record is written
+// once the run is over, so that a shard that was cut short can be told apart.
+// Numbers are in the byte order of the machine, as results are read back by
+// the same test binary.
+#define RESULTS_MAGIC "baro-r1\n"
+
+enum {
+    RESULT_TEST = 1,
+    RESULT_END = 2,
+};
+
+struct result_record {
+    uint32_t type;
+    uint32_t failed;
+    uint64_t id;
+    uint64_t duration_ns;
+    uint64_t num_asserts;
+    uint64_t num_asserts_failed;
+    uint64_t report_size;
+};
+
+static int results_open(
+        char const * const path) {
+#ifdef _WIN32
+    int const fd = _open(path, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_APPEND | _O_BINARY,
+                         _S_IREAD | _S_IWRITE);
+#else
+    int const fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+#endif
+    if (fd == -1 || !write_all(fd, RESULTS_MAGIC, sizeof(RESULTS_MAGIC) - 1)) {
+        return -1;
+    }
+    return fd;
+}
+
+// Appends the result of a test, along with its reports so far. Every record is
+// written at once to a file opened for appending, so that the threads or worker
+// processes writing to the same file never interleave their records.
+static void record_result(
+        struct baro__test const * const test,
+        struct test_result const * const result,
+        int const failed) {
+    struct baro__report const * const report = &baro__c.report;
+    struct result_record const record = {
+            .type = RESULT_TEST,
+            .failed = (uint32_t) failed,
+            .id = test_ids_find(runner.ids, test->tag),
+            .duration_ns = result->duration_ns,
+            .num_asserts = result->num_asserts,
+            .num_asserts_failed = result->num_asserts_failed,
+            .report_size = report->size,
+    };
+
+    struct baro__report * const out = &formatted_result;
+    char * const data = baro__report_reserve(out, sizeof(record) + report->size);
+    memcpy(data, &record, sizeof(record));
+    if (report->size > 0) {
+        memcpy(data + sizeof(record), report->data, report->size);
+    }
+
+    if (!write_all(runner.results_fd, data, sizeof(record) + report->size)) {
+        fprintf(stderr, "Failed to write the result of %s\n", test->tag->desc);
+    }
+}
+
+static int results_close(
+        int const fd) {
+    struct result_record const record = {.type = RESULT_END};
+    int const written = write_all(fd, &record, sizeof(record));
+    return close(fd) == 0 && written;
+}
+
+struct tag_by_id {
+    uint64_t id;
+    struct baro__tag const *tag;
+};
+
+static int tag_by_id_cmp(
+        void const * const a,
+        void const * const b) {
+    uint64_t const lhs = ((struct tag_by_id const *) a)->id;
+    uint64_t const rhs = ((struct tag_by_id const *) b)->id;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+// Writes the results of every file, one file after another, in the format
+// being written, as if they were the results of a single run. Only a single
+// record is held at a time, however many results there are. Returns the exit
+// status of the merged run.
+static int merge_results(
+        char * const * const paths,
+        size_t const num_paths) {
+    struct test_ids const * const ids = runner.ids;
+    struct tag_by_id * const tags = malloc((ids->capacity + 1) * sizeof(struct tag_by_id));
+    size_t num_tags = 0;
+    for (size_t i = 0; i < ids->capacity; i++) {
+        if (ids->tags[i] != NULL) {
+            tags[num_tags].id = ids->ids[i];
+            tags[num_tags++].tag = ids->tags[i];
+        }
+    }
+    qsort(tags, num_tags, sizeof(struct tag_by_id), tag_by_id_cmp);
+
+    int status = EXIT_PASSED;
+    struct baro__report * const report = &baro__c.report;
+    size_t number = 0;
+
+    for (size_t i = 0; i < num_paths; i++) {
+        FILE * const file = fopen(paths[i], "rb");
+        char magic[sizeof(RESULTS_MAGIC) - 1];
+        if (file == NULL || fread(magic, 1, sizeof(magic), file) != sizeof(magic) ||
+            memcmp(magic, RESULTS_MAGIC, sizeof(magic)) != 0) {
+            fprintf(stderr, "Failed to read results from %s\n", paths[i]);
+            if (file != NULL) {
+                fclose(file);
+            }
+            status = EXIT_ERROR;
+            continue;
+        }
+
+        int complete = 0;
+        struct result_record record;
+        while (fread(&record, sizeof(record), 1, file) == 1) {
+            if (record.type == RESULT_END) {
+                complete = 1;
+                break;
+            }
+
+            report->size = 0;
+            if (record.type != RESULT_TEST ||
+                fread(baro__report_reserve(report, record.report_size), 1, record.report_size, file) !=
+                record.report_size) {
+                break;
+            }
+            report->size = record.report_size;
+
+            baro__c.num_tests_ran++;
+            baro__c.num_tests_failed += record.failed != 0;
+            baro__c.num_asserts += record.num_asserts;
+            baro__c.num_asserts_failed += record.num_asserts_failed;
+            if (record.failed && status == EXIT_PASSED) {
+                status = EXIT_FAILED;
+            }
+
+            struct tag_by_id const key = {.id = record.id};
+            struct tag_by_id const * const found = bsearch(&key, tags, num_tags, sizeof(struct tag_by_id),
+                                                           tag_by_id_cmp);
+            if (found == NULL) {
+                fprintf(stderr, "No test has the ID %016llx, from %s\n",
+                        (unsigned long long) record.id, paths[i]);
+                continue;
+            }
+
+            struct baro__test const test = {.tag = found->tag};
+            struct test_result const result = {
+                    .ran = 1,
+                    .duration_ns = record.duration_ns,
+                    .num_asserts = record.num_asserts,
+                    .num_asserts_failed = record.num_asserts_failed,
+            };
+            if (runner.format != FORMAT_TEXT) {
+                format_result(&test, &result, record.failed, ++number);
+            } else if (!record.failed && runner.show_passed_tests) {
+                baro__report_printf(report, BARO__GREEN "Passed: %s (%s:%d)\n" BARO__UNSET_COLOR BARO__SEPARATOR,
+                                    test.tag->desc, extract_file_name(test.tag->file_path), test.tag->line_num);
+            }
+            flush_report();
+        }
+        report->size = 0;
+
+        if (!complete) {
+            fprintf(stderr, "Results in %s end early, as if their run was cut short\n", paths[i]);
+            if (status == EXIT_PASSED) {
+                status = EXIT_FAILED;
+            }
+        }
+        fclose(file);
+    }
+
+    free(tags);
+    return status;
+}
+
+// The shape of the subtest tree of each test, keyed by test ID, as recorded
+// with --discover. Subtests are only found by running into them, so without
+// this the number of leaves in a test is only known once it has run. Shapes
+// are written with one pair of parentheses per subtest, nested as they are,
+// within one pair for the test itself: "(()(()()))" is a test with two
+// subtests, the second of which has two of its own.
+struct tree_entry {
+    uint64_t id;
+    char *shape;
+};
+
+struct tree_table {
+    struct tree_entry *entries;
+    size_t capacity;
+    size_t size;
+};
+
+static struct tree_entry *tree_table_slot(
+        struct tree_table const * const table,
+        uint64_t const id) {
+    size_t index = (size_t) baro__mix64(id) & (table->capacity - 1);
+    while (table->entries[index].shape && table->entries[index].id != id) {
+        index = (index + 1) & (table->capacity - 1);
+    }
+    return &table->entries[index];
+}
+
+static struct tree_entry *tree_table_find(
+        struct tree_table const * const table,
+        uint64_t const id) {
+    if (table->capacity == 0) {
+        return NULL;
+    }
+
+    struct tree_entry * const entry = tree_table_slot(table, id);
+    return entry->shape ? entry : NULL;
+}
+
+// Sets the shape of a test's tree, taking ownership of the shape
+static void tree_table_set(
+        struct tree_table * const table,
+        uint64_t const id,
+        char * const shape) {
+    struct tree_entry * const existing = tree_table_find(table, id);
+    if (existing) {
+        free(existing->shape);
+        existing->shape = shape;
+        return;
+    }
+
+    if ((table->size + 1) * 4 > table->capacity * 3) {
+        struct tree_entry * const old_entries = table->entries;
+        size_t const old_capacity = table->capacity;
+
+        table->capacity = old_capacity ? old_capacity * 2 : 64;
+        table->entries = calloc(table->capacity, sizeof(struct tree_entry));
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (old_entries[i].shape) {
+                *tree_table_slot(table, old_entries[i].id) = old_entries[i];
+            }
+        }
+        free(old_entries);
+    }
+
+    struct tree_entry * const entry = tree_table_slot(table, id);
+    entry->id = id;
+    entry->shape = shape;
+    table->size++;
+}
+
+static void tree_table_destroy(
+        struct tree_table * const table) {
+    for (size_t i = 0; i < table->capacity; i++) {
+        free(table->entries[i].shape);
+    }
+    free(table->entries);
+}
+
+static int tree_table_load(
+        struct tree_table * const table,
+        char const * const path) {
+    FILE * const file = fopen(path, "r");
+    if (file == NULL) {
+        return 0;
+    }
+
+    char *line = NULL;
+    size_t capacity = 0;
+    while (read_line(file, &line, &capacity)) {
+        char *shape;
+        unsigned long long const id = strtoull(line, &shape, 16);
+        if (shape == line || *shape++ != '\t' || *shape != '(') {
+            continue;
+        }
+
+#ifdef _WIN32
+        tree_table_set(table, id, _strdup(shape));
+#else
+        tree_table_set(table, id, strdup(shape));
+#endif
+    }
+
+    free(line);
+    fclose(file);
+    return 1;
+}
+
+static int tree_entry_cmp(
+        void const *lhs,
+        void const *rhs) {
+    struct tree_entry const * const lhs_entry = lhs;
+    struct tree_entry const * const rhs_entry = rhs;
+    return (lhs_entry->id > rhs_entry->id) - (lhs_entry->id < rhs_entry->id);
+}
+
+static void tree_entry_write(
+        FILE * const file,
+        void const * const entry) {
+    struct tree_entry const * const tree = entry;
+    fprintf(file, "%016llx\t%s\n", (unsigned long long) tree->id, tree->shape);
+}
+
+static int tree_table_save(
+        struct tree_table * const table,
+        char const * const path) {
+    return save_sorted_entries(path, table->entries, table->capacity, sizeof(struct tree_entry),
+                               offsetof(struct tree_entry, shape), tree_entry_cmp, tree_entry_write);
+}
+
+// Writes out the tree that a test has explored, once all of its passes ran
+static char *subtest_tree_shape(
+        struct baro__subtest_trie const * const trie) {
+    char * const shape = malloc(2 * trie->size + 1);
+    size_t size = 0;
+
+    // Each entry is a node index shifted left by one, with the low bit set
+    // for closing the node once all of its children have been written
+    size_t * const stack = malloc(2 * trie->size * sizeof(size_t));
+    size_t stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0) {
+        size_t const entry = stack[--stack_size];
+        if (entry & 1u) {
+            shape[size++] = ')';
+            continue;
+        }
+
+        shape[size++] = '(';
+        stack[stack_size++] = entry | 1u;
+
+        // Children are linked newest first, so they come off the stack in the
+        // order that they were found in
+        for (size_t child = trie->nodes[entry >> 1u].first_child; child != 0;
+             child = trie->nodes[child].next_sibling) {
+            stack[stack_size++] = child << 1u;
+        }
+    }
+
+    free(stack);
+    shape[size] = '\0';
+    return shape;
+}
+
+// Benchmark baselines, saved with --save-baseline and compared against with
+// --compare. Each line holds the ID of a benchmark, its location, the time
+// per iteration of every sample it took, in nanoseconds, and its description,
+// separated by tabs:
+//   8c335b474d6738a3	sort.c:35	41250.5,40612,41873.2	sort 1000 integers
+// A benchmark is found by its ID, or failing that by its location, which is
+// how one that was renamed is still compared, and replaced when saving.
+struct baseline_entry {
+    uint64_t id;
+    char *file_name;
+    int line_num;
+    char *desc;
+    double samples[BENCH_MAX_SAMPLES];
+    size_t num_samples;
+
+    // Set once a benchmark in the suite has been found for the entry
+    int matched;
+};
+
+struct baseline_table {
+    struct baseline_entry *entries;
+    size_t size;
+    size_t capacity;
+};
+
+// There are only ever a few benchmarks, so entries are searched in order
+static struct baseline_entry *baseline_table_find(
+        struct baseline_table const * const table,
+        uint64_t const id,
+        struct baro__tag const * const tag) {
+    for (size_t i = 0; i < table->size; i++) {
+        if (table->entries[i].id == id) {
+            return &table->entries[i];
+        }
+    }
+
+    char const * const file_name = extract_file_name(tag->file_path);
+    for (size_t i = 0; i < table->size; i++) {
+        struct baseline_entry * const entry = &table->entries[i];
+        if (entry->line_num == tag->line_num && strcmp(entry->file_name, file_name) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Adds an entry, taking ownership of its strings, or replaces the entry of
+// the same benchmark
+static void baseline_table_set(
+        struct baseline_table * const table,
+        struct baseline_entry const * const entry,
+        struct baro__tag const * const tag) {
+    struct baseline_entry *existing = tag != NULL ? baseline_table_find(table, entry->id, tag) : NULL;
+    if (existing == NULL) {
+        if (table->size == table->capacity) {
+            table->capacity = table->capacity ? table->capacity * 2 : 16;
+            table->entries = realloc(table->entries, table->capacity * sizeof(struct baseline_entry));
+        }
+        existing = &table->entries[table->size++];
+    } else {
+        free(existing->file_name);
+        free(existing->desc);
+    }
+    *existing = *entry;
+}
+
+static void baseline_table_destroy(
+        struct baseline_table * const table) {
+    for (size_t i = 0; i < table->size; i++) {
+        free(table->entries[i].file_name);
+        free(table->entries[i].desc);
+    }
+    free(table->entries);
+}
+
+static char *copy_string(
+        char const * const str,
+        size_t const size) {
+    char * const copy = malloc(size + 1);
+    memcpy(copy, str, size);
+    copy[size] = '\0';
+    return copy;
+}
+
+static int baseline_table_load(
+        struct baseline_table * const table,
+        char const * const path) {
+    FILE * const file = fopen(path, "r");
+    if (file == NULL) {
+        return 0;
+    }
+
+    char *line = NULL;
+    size_t capacity = 0;
+    while (read_line(file, &line, &capacity)) {
+        struct baseline_entry entry = {0};
+        char *p;
+        entry.id = strtoull(line, &p, 16);
+        char * const location = p + 1;
+        char * const samples = p != line && *p == '\t' ? strchr(location, '\t') : NULL;
+        char * const desc = samples != NULL ? strchr(samples + 1, '\t') : NULL;
+        char * const colon = desc != NULL ? memchr(location, ':', (size_t) (samples - location)) : NULL;
+        if (colon == NULL) {
+            continue;
+        }
+
+        // Samples past the most that a run takes are left out
+        p = samples;
+        while (entry.num_samples < BENCH_MAX_SAMPLES && (*p == '\t' || *p == ',') && p + 1 != desc) {
+            char *end;
+            double const sample = strtod(p + 1, &end);
+            if (end == p + 1) {
+                break;
+            }
+            entry.samples[entry.num_samples++] = sample;
+            p = end;
+        }
+        if (entry.num_samples == 0) {
+            continue;
+        }
+
+        entry.file_name = copy_string(location, (size_t) (colon - location));
+        entry.line_num = (int) strtol(colon + 1, NULL, 10);
+        entry.desc = copy_string(desc + 1, strlen(desc + 1));
+        baseline_table_set(table, &entry, NULL);
+    }
+
+    free(line);
+    fclose(file);
+    return 1;
+}
+
+static int baseline_entry_cmp(
+        void const *lhs,
+        void const *rhs) {
+    struct baseline_entry const * const lhs_entry = lhs;
+    struct baseline_entry const * const rhs_entry = rhs;
+    return (lhs_entry->id > rhs_entry->id) - (lhs_entry->id < rhs_entry->id);
+}
+
+static void baseline_entry_write(
+        FILE * const file,
+        void const * const entry) {
+    struct baseline_entry const * const baseline = entry;
+    fprintf(file, "%016llx\t%s:%d", (unsigned long long) baseline->id, baseline->file_name, baseline->line_num);
+    for (size_t i = 0; i < baseline->num_samples; i++) {
+        fprintf(file, "%c%.6g", i == 0 ? '\t' : ',', baseline->samples[i]);
+    }
+    fprintf(file, "\t%s\n", baseline->desc);
+}
+
+// Every entry in the table is in use, as it isn't hashed
+static int baseline_table_save(
+        struct baseline_table * const table,
+        char const * const path) {
+    return save_sorted_entries(path, table->entries, table->size, sizeof(struct baseline_entry),
+                               offsetof(struct baseline_entry, file_name), baseline_entry_cmp, baseline_entry_write);
+}
+
+// The one-sided p-value of the Mann-Whitney U test, for the samples in
+// `current` tending to be larger than those in `baseline`. U counts the pairs
+// of samples where the current one is larger, with ties counting half, and is
+// checked against its exact distribution when both come from the same one.
+// The number of orderings of i current and j baseline samples that give each
+// U is built up one baseline sample at a time: the largest sample is either a
+// current one, which is larger than all j baseline samples, or a baseline one.
+static double mann_whitney_p(
+        double const * const current,
+        size_t const num_current,
+        double const * const baseline,
+        size_t const num_baseline) {
+    double u = 0;
+    for (size_t i = 0; i < num_current; i++) {
+        for (size_t j = 0; j < num_baseline; j++) {
+            u += current[i] > baseline[j] ? 1 : current[i] == baseline[j] ? 0.5 : 0;
+        }
+    }
+
+    size_t const num_u = num_current * num_baseline + 1;
+    double * const counts = calloc((num_current + 1) * num_u, sizeof(double));
+    for (size_t i = 0; i <= num_current; i++) {
+        counts[i * num_u] = 1;
+    }
+    for (size_t j = 1; j <= num_baseline; j++) {
+        for (size_t i = 1; i <= num_current; i++) {
+            for (size_t k = num_u - 1; k >= j; k--) {
+                counts[i * num_u + k] += counts[(i - 1) * num_u + k - j];
+            }
+        }
+    }
+
+    double total = 0;
+    double at_least_u = 0;
+    for (size_t k = 0; k < num_u; k++) {
+        total += counts[num_current * num_u + k];
+        if ((double) k >= u) {
+            at_least_u += counts[num_current * num_u + k];
+        }
+    }
+
+    free(counts);
+    return at_least_u / total;
+}
+
+#ifdef BARO_SELF_TEST
+// For the unit tests of the runner itself
+double baro__mann_whitney_p(
+        double const *current,
+        size_t num_current,
+        double const *baseline,
+        size_t num_baseline);
+
+double baro__mann_whitney_p(
+        double const * const current,
+        size_t const num_current,
+        double const * const baseline,
+        size_t const num_baseline) {
+    return mann_whitney_p(current, num_current, baseline, num_baseline);
+}
+#endif
+
+// Only a slowdown that is this unlikely to be down to chance fails a benchmark
+#define BENCH_SIGNIFICANCE 0.01
+
+// Compares a benchmark with its baseline, if it has one. It fails when its
+// median time per iteration got slower by more than the threshold, and the
+// samples show it to be significant. Returns non-zero if it failed.
+static int bench_compare(
+        struct baro__test const * const test,
+        struct test_result * const result) {
+    struct baseline_entry * const entry = baseline_table_find(runner.baseline,
+                                                              test_ids_find(runner.ids, test->tag), test->tag);
+    if (entry == NULL) {
+        return 0;
+    }
+    entry->matched = 1;
+
+    struct bench_stats stats, baseline_stats;
+    bench_stats_compute(&stats, result->bench_samples, result->bench_num_samples);
+    bench_stats_compute(&baseline_stats, entry->samples, entry->num_samples);
+
+    result->bench_compared = 1;
+    result->bench_baseline_ns = baseline_stats.median_ns;
+    result->bench_p_value = mann_whitney_p(result->bench_samples, result->bench_num_samples,
+                                           entry->samples, entry->num_samples);
+    result->bench_renamed_from = strcmp(entry->desc, test->tag->desc) != 0 ? entry->desc : NULL;
+
+    double const change = (stats.median_ns / baseline_stats.median_ns - 1) * 100;
+    if (change <= runner.regression_threshold || result->bench_p_value >= BENCH_SIGNIFICANCE) {
+        return 0;
+    }
+
+    char median[32], baseline[32];
+    format_bench_time(median, sizeof(median), stats.median_ns);
+    format_bench_time(baseline, sizeof(baseline), baseline_stats.median_ns);
+
+    struct baro__report * const out = &baro__c.report;
+    baro__report_printf(out, BARO__RED "Benchmark regressed: %.1f%% slower than its baseline\n" BARO__UNSET_COLOR,
+                        change);
+    baro__report_printf(out, "    %s per iteration, from %s (p = %.3g)\n", median, baseline, result->bench_p_value);
+    baro__report_printf(out, "  In: %s (%s:%d)\n",
+                        test->tag->desc, extract_file_name(test->tag->file_path), test->tag->line_num);
+    if (result->bench_renamed_from != NULL) {
+        baro__report_printf(out, "    Saved as: %s\n", result->bench_renamed_from);
+    }
+    baro__report_printf(out, BARO__SEPARATOR);
+    return 1;
+}
+
+// Every leaf takes a pass through the test of its own
+static uint64_t subtest_tree_num_leaves(
+        char const *shape) {
+    uint64_t num_leaves = 0;
+    for (; *shape; shape++) {
+        if (shape[0] == '(' && shape[1] == ')') {
+            num_leaves++;
+        }
+    }
+    return num_leaves;
+}
+
+// Weighs tests by how long they took last time. New tests are assumed to take
+// an average amount of time.
+static uint64_t *duration_weights(
+        struct baro__test const * const tests,
+        size_t const num_tests,
+        struct duration_table * const durations) {
+    uint64_t * const weights = calloc(num_tests + 1, sizeof(uint64_t));
+    uint64_t total_known_us = 0;
+    size_t num_known = 0;
+    for (size_t i = 0; i < num_tests; i++) {
+        char * const key = duration_key(&tests[i]);
+        struct duration_entry const * const entry = duration_table_find(durations, key);
+        if (entry) {
+            // Even the quickest test costs something, and a weight of zero
+            // would pile all of them into the same partition
+            weights[i] = entry->duration_us > 0 ? entry->duration_us : 1;
+            total_known_us += weights[i];
+            num_known++;
+        }
+        free(key);
+    }
+
+    uint64_t const unknown_weight = num_known > 0 ? total_known_us / num_known : 1;
+    for (size_t i = 0; i < num_tests; i++) {
+        if (weights[i] == 0) {
+            weights[i] = unknown_weight > 0 ? unknown_weight : 1;
+        }
+    }
+    return weights;
+}
+
+// Weighs tests by the number of leaves in their subtree, as each of those
+// takes a pass of its own. Tests that were never discovered are assumed to be
+// of average size.
+static uint64_t *leaf_weights(
+        struct baro__test const * const tests,
+        size_t const num_tests,
+        struct tree_table const * const trees,
+        struct test_ids const * const ids) {
+    uint64_t * const weights = calloc(num_tests + 1, sizeof(uint64_t));
+    uint64_t total_known = 0;
+    size_t num_known = 0;
+    for (size_t i = 0; i < num_tests; i++) {
+        struct tree_entry const * const entry = tree_table_find(trees, test_ids_find(ids, tests[i].tag));
+        if (entry) {
+            weights[i] = subtest_tree_num_leaves(entry->shape);
+            total_known += weights[i];
+            num_known++;
+        }
+    }
+
+    uint64_t const unknown_weight = num_known > 0 ? total_known / num_known : 1;
+    for (size_t i = 0; i < num_tests; i++) {
+        if (weights[i] == 0) {
+            weights[i] = unknown_weight > 0 ? unknown_weight : 1;
+        }
+    }
+    return weights;
+}
+
+struct partition_item {
+    uint64_t weight;
+    size_t position;
+};
+
+static int partition_item_cmp(
+        void const *lhs,
+        void const *rhs) {
+    struct partition_item const * const lhs_item = lhs;
+    struct partition_item const * const rhs_item = rhs;
+
+    if (lhs_item->weight != rhs_item->weight) {
+        return lhs_item->weight > rhs_item->weight ? -1 : 1;
+    }
+    return lhs_item->position < rhs_item->position ? -1 : lhs_item->position > rhs_item->position;
+}
+
+// Assigns every test to a partition with longest-processing-time-first bin
+// packing: the slowest remaining test always goes to the least loaded
+// partition. Ties are broken by position and partition index, so every
+// partition computes exactly the same plan without coordinating.
+static void plan_partitions(
+        uint64_t const * const weights,
+        size_t const num_tests,
+        size_t const num_partitions,
+        size_t * const assignments) {
+    struct partition_item * const items = calloc(num_tests, sizeof(struct partition_item));
+    for (size_t i = 0; i < num_tests; i++) {
+        items[i].weight = weights[i];
+        items[i].position = i;
+    }
+    qsort(items, num_tests, sizeof(struct partition_item), partition_item_cmp);
+
+    uint64_t * const loads = calloc(num_partitions, sizeof(uint64_t));
+    for (size_t i = 0; i < num_tests; i++) {
+        size_t lightest = 0;
+        for (size_t j = 1; j < num_partitions; j++) {
+            if (loads[j] < loads[lightest]) {
+                lightest = j;
+            }
+        }
+
+        loads[lightest] += items[i].weight;
+        assignments[items[i].position] = lightest;
+    }
+
+    free(loads);
+    free(items);
+}
+
+static int slowest_test_cmp(
+        void const * const a,
+        void const * const b) {
+    size_t const lhs = *(size_t const *) a;
+    size_t const rhs = *(size_t const *) b;
+    uint64_t const lhs_ns = runner.results[lhs].duration_ns;
+    uint64_t const rhs_ns = runner.results[rhs].duration_ns;
+
+    if (lhs_ns != rhs_ns) {
+        return lhs_ns < rhs_ns ? 1 : -1;
+    }
+    return lhs < rhs ? -1 : lhs > rhs;
+}
+
+static int slowest_leaf_cmp(
+        void const * const a,
+        void const * const b) {
+    uint64_t const lhs_ns = leaf_timing_total_ns(a);
+    uint64_t const rhs_ns = leaf_timing_total_ns(b);
+    return lhs_ns < rhs_ns ? 1 : lhs_ns > rhs_ns ? -1 : 0;
+}
+
+// Prints what a test or subtest leaf allocated, when allocations were tracked
+static void print_allocs(
+        struct alloc_stats const * const allocs) {
+    if (allocs->tracked) {
+        printf("%12s     %llu allocation%s, %llu bytes, peaking at %llu bytes\n", "",
+               (unsigned long long) allocs->count, allocs->count == 1 ? "" : "s",
+               (unsigned long long) allocs->bytes, (unsigned long long) allocs->peak_bytes);
+    }
+}
 
-char *optarg;
+// Prints the slowest tests and subtest leaves, splitting their time between
+// what is unique to them and the code that every pass re-runs
+static void print_slowest(
+        struct baro__test const * const tests,
+        size_t const num_tests) {
+    size_t * const order = calloc(num_tests + 1, sizeof(size_t));
+    size_t num_ran = 0;
+    for (size_t i = 0; i < num_tests; i++) {
+        if (runner.results[i].ran) {
+            order[num_ran++] = i;
+        }
+    }
+    qsort(order, num_ran, sizeof(size_t), slowest_test_cmp);
 
-// A small getopt-like function for parsing short CLI arguments
-int getopt(
-        int const num_args,
-        char * const * args,
-        char const * opts) {
-    static char *arg = "";
-    static int cur_arg = 1;
+    size_t const num_shown = num_ran < runner.num_slowest ? num_ran : runner.num_slowest;
+    printf("Slowest %zu test%s:\n", num_shown, num_shown == 1 ? "" : "s");
+    for (size_t i = 0; i < num_shown; i++) {
+        struct baro__test const * const test = &tests[order[i]];
+        struct test_result const * const result = &runner.results[order[i]];
 
-    if (!*arg) {
-        if (cur_arg >= num_args || *(arg = args[cur_arg]) != '-') {
-            arg = "";
-            return -1;
+        printf("%12.3f ms  %s (%s:%d)\n", result->duration_ns / 1e6,
+               test->tag->desc, extract_file_name(test->tag->file_path), test->tag->line_num);
+        if (result->num_passes > 1) {
+            printf("%12s     %.3f ms outside of subtests, over %zu passes\n", "",
+                   result->prefix_ns / 1e6, result->num_passes);
         }
-        if (arg[1] && *++arg == '-') {
-            ++cur_arg;
-            arg = "";
-            fprintf(stderr, "Long options not supported\n");
-            return 0;
+        if (result->counters.available) {
+            char counters[160];
+            printf("%12s     %s\n", "", format_counters(counters, sizeof(counters), &result->counters, 1));
         }
+        print_allocs(&result->allocs);
     }
+    free(order);
 
-    char opt;
-    char const *cur_opt;
+    qsort(runner.slowest_leaves, runner.num_slowest_leaves, sizeof(struct leaf_timing), slowest_leaf_cmp);
 
-    if ((opt = *arg++) == ':' || !(cur_opt = strchr(opts, opt))) {
-        if (opt == '-') {
-            return -1;
-        }
-        if (!*arg) {
-            ++cur_arg;
-        }
-        fprintf(stderr, "Illegal option: %c\n", opt);
-        return 0;
+    if (runner.num_slowest_leaves > 0) {
+        printf("Slowest %zu subtest%s:\n", runner.num_slowest_leaves,
+               runner.num_slowest_leaves == 1 ? "" : "s");
     }
+    for (size_t i = 0; i < runner.num_slowest_leaves; i++) {
+        struct leaf_timing const * const timing = &runner.slowest_leaves[i];
 
-    if (*++cur_opt != ':') {
-        optarg = NULL;
-        if (!*arg) {
-            ++cur_arg;
-        }
-    } else {
-        if (*arg) {
-            optarg = arg;
-        } else if (num_args <= ++cur_arg) {
-            arg = "";
-            fprintf(stderr, "Option requires an argument: %c\n", opt);
-            return 0;
-        } else {
-            optarg = args[cur_arg];
-        }
-        arg = "";
-        ++cur_arg;
+        printf("%12.3f ms  %s (%s:%d), in %s\n", leaf_timing_total_ns(timing) / 1e6,
+               timing->leaf->desc, extract_file_name(timing->leaf->file_path), timing->leaf->line_num,
+               timing->test->tag->desc);
+        printf("%12s     %.3f ms outside of the subtest, %.3f ms inside\n", "",
+               timing->prefix_ns / 1e6, timing->leaf_ns / 1e6);
+        print_allocs(&timing->allocs);
     }
 
-    return opt;
+    printf(BARO__SEPARATOR);
 }
 
-static void set_sigabrt_handler(void (*handler)(int)) {
-#ifdef _WIN32
-    signal(SIGABRT, handler);
-#else
-    struct sigaction action;
-    memset(&action, 0, sizeof(struct sigaction));
-    action.sa_handler = handler;
-    sigaction(SIGABRT, &action, NULL);
-#endif
+// Writes what comes before the results of the first test, as the format has it
+static void print_header(void) {
+    switch (runner.format) {
+    case FORMAT_TEXT:
+        printf(BARO__SEPARATOR);
+        break;
+
+    case FORMAT_JSONL:
+        break;
+
+    case FORMAT_JUNIT:
+        printf("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<testsuite name=\"baro\">\n");
+        break;
+
+    case FORMAT_TAP:
+        printf("TAP version 13\n");
+        break;
+    }
 }
 
-static void handle_signal(int signum) {
-    if (signum == SIGABRT) {
-        set_sigabrt_handler(NULL);
+// Writes the totals of the run, as the format has them
+static void print_summary(void) {
+    switch (runner.format) {
+    case FORMAT_TEXT:
+        printf("tests:   %5zu total | " BARO__GREEN "%5zu passed" BARO__UNSET_COLOR
+               " | " BARO__RED "%5zu failed" BARO__UNSET_COLOR "\n",
+               baro__c.num_tests_ran, baro__c.num_tests_ran - baro__c.num_tests_failed,
+               baro__c.num_tests_failed);
 
-        // Return to the main loop because we can't do anything useful while
-        // still in the signal handler
-        longjmp(baro__c.env, BARO__JMP_SIGABRT);
+        printf("asserts: %5zu total | " BARO__GREEN "%5zu passed" BARO__UNSET_COLOR
+               " | " BARO__RED "%5zu failed" BARO__UNSET_COLOR "\n",
+               baro__c.num_asserts, baro__c.num_asserts - baro__c.num_asserts_failed,
+               baro__c.num_asserts_failed);
+        break;
+
+    case FORMAT_JSONL:
+        printf("{\"type\":\"summary\",\"tests\":%zu,\"tests_failed\":%zu,"
+               "\"asserts\":%zu,\"asserts_failed\":%zu}\n",
+               baro__c.num_tests_ran, baro__c.num_tests_failed,
+               baro__c.num_asserts, baro__c.num_asserts_failed);
+        break;
+
+    case FORMAT_JUNIT:
+        printf("</testsuite>\n");
+        break;
+
+    case FORMAT_TAP:
+        break;
     }
 }
 
 int main(
         int argc,
         char *argv[]) {
-    int show_passed_tests = 0;
-    int suppress_stdout = 1;
     int suppress_stderr = 0;
-    int stop_after_failure = 0;
     size_t num_partitions = 1;
     size_t cur_partition = 1;
+    size_t num_threads = 1;
+    size_t num_fork_workers = 0;
     char *raw_tag_filters = NULL;
+    char *raw_path = NULL;
+    char **path_parts = NULL;
+    char const *durations_path = NULL;
+    char const *ids_path = NULL;
+    char const *discover_path = NULL;
+    char const *trees_path = NULL;
+    char const *results_path = NULL;
+    char const *save_baseline_path = NULL;
+    char const *compare_path = NULL;
+    int list_tests = 0;
+    int merge = 0;
+
+    runner.suppress_stdout = 1;
+    runner.results_fd = -1;
+    runner.bench_time_ns = 500000000u;
+    runner.regression_threshold = 5;
+
+#ifdef BARO__TEST_SECTION
+    // Compilation units built with BARO_NO_TEST_SECTION, or that aren't ELF,
+    // register their tests from constructors instead, which are kept along
+    // with those in the section
+    size_t const num_section_tests = (size_t) (__stop_baro_tests - __start_baro_tests);
+    if (baro__tests.size == 0) {
+        baro__tests.tests = __start_baro_tests;
+        baro__tests.size = baro__tests.capacity = num_section_tests;
+    } else {
+        for (size_t i = 0; i < num_section_tests; i++) {
+            baro__test_list_add(&baro__tests, &__start_baro_tests[i]);
+        }
+    }
+#endif
+    size_t const total_num_tests = baro__tests.size;
 
-    size_t const total_num_tests = baro__c.tests.size;
+    baro__context_create(&baro__c);
+
+    enum {
+        OPT_FORK_WORKERS = 256,
+        OPT_DURATIONS,
+        OPT_SLOWEST,
+        OPT_FORK_SUBTESTS,
+        OPT_PATH,
+        OPT_LIST,
+        OPT_IDS,
+        OPT_DISCOVER,
+        OPT_TREES,
+        OPT_OUTPUT_TAIL,
+        OPT_FORMAT,
+        OPT_RESULTS,
+        OPT_MERGE,
+        OPT_BENCH,
+        OPT_BENCH_TIME,
+        OPT_SAVE_BASELINE,
+        OPT_COMPARE,
+        OPT_REGRESSION_THRESHOLD,
+        OPT_COUNTERS,
+        OPT_TIMEOUT,
+    };
+
+    struct long_option const long_options[] = {
+            {"fork-workers", 1, OPT_FORK_WORKERS},
+            {"durations", 1, OPT_DURATIONS},
+            {"slowest", 1, OPT_SLOWEST},
+            {"fork-subtests", 0, OPT_FORK_SUBTESTS},
+            {"path", 1, OPT_PATH},
+            {"list", 0, OPT_LIST},
+            {"ids", 1, OPT_IDS},
+            {"discover", 1, OPT_DISCOVER},
+            {"trees", 1, OPT_TREES},
+            {"output-tail", 1, OPT_OUTPUT_TAIL},
+            {"format", 1, OPT_FORMAT},
+            {"results", 1, OPT_RESULTS},
+            {"merge", 0, OPT_MERGE},
+            {"bench", 0, OPT_BENCH},
+            {"bench-time", 1, OPT_BENCH_TIME},
+            {"save-baseline", 1, OPT_SAVE_BASELINE},
+            {"compare", 1, OPT_COMPARE},
+            {"regression-threshold", 1, OPT_REGRESSION_THRESHOLD},
+            {"counters", 0, OPT_COUNTERS},
+            {"timeout", 1, OPT_TIMEOUT},
+            {NULL, 0, 0},
+    };
 
     // Parse command line options
     int c;
-    while ((c = getopt(argc, argv, "haoesp:n:t:")) != -1) {
+    while ((c = get_option(argc, argv, "haoesp:n:t:j:", long_options)) != -1) {
         switch (c) {
         case 'p':
             num_partitions = strtol(optarg, NULL, 10);
@@ -108,12 +4681,152 @@ int main(
             cur_partition = strtol(optarg, NULL, 10);
             break;
 
+        case 'j':
+            num_threads = strtol(optarg, NULL, 10);
+            break;
+
+        case OPT_FORK_WORKERS:
+            num_fork_workers = strtol(optarg, NULL, 10);
+            if (num_fork_workers < 1) {
+                fprintf(stderr, "Invalid number of fork workers %s, value should "
+                                "be at least 1\n", optarg);
+                return EXIT_ERROR;
+            }
+            break;
+
+        case OPT_DURATIONS:
+            durations_path = optarg;
+            break;
+
+        case OPT_PATH:
+#ifdef _WIN32
+            raw_path = _strdup(optarg);
+#else
+            raw_path = strdup(optarg);
+#endif
+            break;
+
+        case OPT_FORK_SUBTESTS:
+            baro__c.fork_subtests = 1;
+            break;
+
+        case OPT_LIST:
+            list_tests = 1;
+            break;
+
+        case OPT_IDS:
+            ids_path = optarg;
+            break;
+
+        case OPT_DISCOVER:
+            discover_path = optarg;
+            break;
+
+        case OPT_TREES:
+            trees_path = optarg;
+            break;
+
+        case OPT_OUTPUT_TAIL: {
+            long const tail_size = strtol(optarg, NULL, 10);
+            if (tail_size < 1) {
+                fprintf(stderr, "Invalid output tail size %s, value should be "
+                                "at least 1\n", optarg);
+                return EXIT_ERROR;
+            }
+            baro__c.stdout_tail_size = tail_size;
+            break;
+        }
+
+        case OPT_FORMAT:
+            if (strcmp(optarg, "text") == 0) {
+                runner.format = FORMAT_TEXT;
+            } else if (strcmp(optarg, "jsonl") == 0) {
+                runner.format = FORMAT_JSONL;
+            } else if (strcmp(optarg, "junit") == 0) {
+                runner.format = FORMAT_JUNIT;
+            } else if (strcmp(optarg, "tap") == 0) {
+                runner.format = FORMAT_TAP;
+            } else {
+                fprintf(stderr, "Invalid format %s, value should be one of text, "
+                                "jsonl, junit or tap\n", optarg);
+                return EXIT_ERROR;
+            }
+            break;
+
+        case OPT_RESULTS:
+            results_path = optarg;
+            break;
+
+        case OPT_MERGE:
+            merge = 1;
+            break;
+
+        case OPT_BENCH:
+            runner.bench = 1;
+            break;
+
+        case OPT_BENCH_TIME: {
+            long const bench_time_ms = strtol(optarg, NULL, 10);
+            if (bench_time_ms < 1) {
+                fprintf(stderr, "Invalid benchmark time %s, value should be at "
+                                "least 1\n", optarg);
+                return EXIT_ERROR;
+            }
+            runner.bench_time_ns = (uint64_t) bench_time_ms * 1000000u;
+            break;
+        }
+
+        case OPT_COUNTERS:
+            runner.counters = 1;
+            break;
+
+        case OPT_TIMEOUT: {
+            long const timeout_ms = strtol(optarg, NULL, 10);
+            if (timeout_ms < 1) {
+                fprintf(stderr, "Invalid timeout %s, value should be at least "
+                                "1\n", optarg);
+                return EXIT_ERROR;
+            }
+            runner.timeout_ns = (uint64_t) timeout_ms * 1000000u;
+            break;
+        }
+
+        case OPT_SAVE_BASELINE:
+            save_baseline_path = optarg;
+            break;
+
+        case OPT_COMPARE:
+            compare_path = optarg;
+            break;
+
+        case OPT_REGRESSION_THRESHOLD: {
+            char *end;
+            runner.regression_threshold = strtod(optarg, &end);
+            if (end == optarg || runner.regression_threshold < 0) {
+                fprintf(stderr, "Invalid regression threshold %s, value should "
+                                "be a percentage of at least 0\n", optarg);
+                return EXIT_ERROR;
+            }
+            break;
+        }
+
+        case OPT_SLOWEST: {
+            long const num_slowest = strtol(optarg, NULL, 10);
+            if (num_slowest < 1) {
+                fprintf(stderr, "Invalid number of slowest tests %s, value should "
+                                "be at least 1\n", optarg);
+                return EXIT_ERROR;
+            }
+            runner.num_slowest = num_slowest;
+            break;
+        }
+
         case 'a':
-            show_passed_tests = 1;
+            runner.show_passed_tests = 1;
             break;
 
         case 'o':
-            suppress_stdout = 0;
+            runner.suppress_stdout = 0;
             break;
             
         case 'e':
@@ -121,7 +4834,7 @@ int main(
             break;
 
         case 's':
-            stop_after_failure = 1;
+            runner.stop_after_failure = 1;
             break;
 
         case 't':
@@ -135,219 +4848,561 @@ int main(
         case 'h':
             printf("Unit test suite, powered by baro; %zu tests loaded\n"
                    "Usage: %s [options]\n"
+                   "       %s [options] --merge <files>...\n"
                    "Options:\n"
                    "  -a                   Show all tests, even passing ones\n"
                    "  -o                   Show all standard output (stdout), including passed tests\n"
+                   "  --output-tail <n>    Show the last n bytes of stdout for failed tests (4096)\n"
                    "  -e                   Hide standard error (stderr) output\n"
                    "  -s                   Stop running after the first failure\n"
-                   "  -t <tag1,tag2,...>   Only run tests with one of these [tags]\n"
+                   "  -t <expression>      Only run tests whose [tags] match, e.g. \"(a|b) & !c\"\n"
+                   "  --path <test>a>b>... Only run the given test, down the given subtests\n"
                    "  -p <num_partitions>  Total number of partitions, 1-based\n"
                    "  -n <cur_partition>   Current partition index, 1-based\n"
+                   "  -j <num_threads>     Number of threads to run tests on\n"
+                   "  --fork-workers <n>   Run tests in n forked worker processes\n"
+                   "  --durations <file>   Balance partitions using, and record, test durations\n"
+                   "  --slowest <n>        Show the n slowest tests and subtests\n"
+                   "  --fork-subtests      Run each subtest in a process forked from its parent\n"
+                   "  --list               List the ID, location and description of tests, without running them\n"
+                   "  --ids <file>         Only run the tests with the IDs listed in a file\n"
+                   "  --discover <file>    Record the subtree of every test that is run\n"
+                   "  --trees <file>       Plan partitions and threads by recorded subtrees\n"
+                   "  --format <format>    Write results as text, jsonl, junit or tap\n"
+                   "  --results <file>     Also write results to a file, for merging later\n"
+                   "  --merge <files>...   Write the results in the given files as one run\n"
+                   "  --bench              Run the benchmarks instead of the tests\n"
+                   "  --bench-time <ms>    Time to spend sampling each benchmark (500)\n"
+                   "  --save-baseline <file>\n"
+                   "                       Save benchmark samples, to compare against later\n"
+                   "  --compare <file>     Fail benchmarks that got slower than a saved baseline\n"
+                   "  --regression-threshold <percent>\n"
+                   "                       How much slower a benchmark can get, in percent (5)\n"
+                   "  --counters           Count cycles, instructions, branch and cache misses\n"
+                   "  --timeout <ms>       Fail tests that run for longer, and move on\n"
                    "  -h                   Show this help text\n",
-                   total_num_tests, argv[0]);
+                   total_num_tests, argv[0], argv[0]);
             return 0;
 
         default:
             fprintf(stderr, "Unknown arguments: run with -h for help\n");
-            return -1;
+            return EXIT_ERROR;
         }
     }
 
     if (total_num_tests == 0) {
         fprintf(stderr, "Zero test cases were found! This usually means that "
                         "something went wrong with test registration.\n");
-        return -1;
+        return EXIT_ERROR;
     }
 
-    // Filter out tests
-    struct baro__test_list tests;
-    if (raw_tag_filters != NULL && raw_tag_filters[0] != '\0') {
-        baro__test_list_create(&tests,baro__c.tests.size);
+    if (num_threads < 1) {
+        fprintf(stderr, "Invalid number of threads %zu, value should be at "
+                        "least 1\n", num_threads);
+        return EXIT_ERROR;
+    }
 
-        // Parse the filter list
-        size_t num_filters = 1;
-        char *p = raw_tag_filters;
-        while (*p) {
-            if (*p++ == ',') {
-                num_filters++;
-            }
-        }
+    if (num_fork_workers > 0 && num_threads > 1) {
+        fprintf(stderr, "-j and --fork-workers can't be used together\n");
+        return EXIT_ERROR;
+    }
+
+    if (baro__c.fork_subtests && num_threads > 1) {
+        fprintf(stderr, "-j and --fork-subtests can't be used together\n");
+        return EXIT_ERROR;
+    }
+
+    // Only a single process running every pass of a test sees its whole tree
+    if (discover_path != NULL && (num_threads > 1 || num_fork_workers > 0 ||
+                                  baro__c.fork_subtests || raw_path != NULL)) {
+        fprintf(stderr, "--discover can't be used with -j, --fork-workers, "
+                        "--fork-subtests or --path\n");
+        return EXIT_ERROR;
+    }
+
+    if (runner.format != FORMAT_TEXT && runner.num_slowest > 0) {
+        fprintf(stderr, "--slowest can only be used with the text format\n");
+        return EXIT_ERROR;
+    }
 
-        char **filters = malloc(num_filters * sizeof(char *));
+    // Benchmarks running side by side would only slow each other down
+    if (runner.bench && (num_threads > 1 || num_fork_workers > 0)) {
+        fprintf(stderr, "--bench can't be used with -j or --fork-workers\n");
+        return EXIT_ERROR;
+    }
 
-        char* next_token = NULL;
 #ifdef _WIN32
-        p = strtok_s(raw_tag_filters, ",", &next_token);
+    if (runner.timeout_ns > 0) {
+        fprintf(stderr, "--timeout isn't supported on Windows\n");
+        return EXIT_ERROR;
+    }
 #else
-        p = strtok_r(raw_tag_filters, ",", &next_token);
+    // A test cut short on one thread may leave locks held that the others
+    // need, where worker processes are simply replaced
+    if (runner.timeout_ns > 0 && num_threads > 1) {
+        fprintf(stderr, "-j can't be used with --timeout, use --fork-workers instead\n");
+        return EXIT_ERROR;
+    }
+    if (runner.timeout_ns > 0) {
+        set_timeout_handler();
+    }
 #endif
-        for (size_t i = 0; i < num_filters; i++) {
-            if (p == NULL) {
-                filters[i] = NULL;
-                continue;
-            }
 
-            // Skip whitespace
-            while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
-                p++;
-            }
+    // Counters are often out of reach in containers and virtual machines, in
+    // which case tests simply run without them
+    if (runner.counters) {
+        uint64_t values[BARO__NUM_COUNTERS];
+        if (baro__read_counters(values) == 0) {
+            fprintf(stderr, "Hardware counters are not available, and won't be shown\n");
+            runner.counters = 0;
+        }
+    }
 
-            size_t const filter_len = strlen(p);
-            if (filter_len == 0) {
-                fprintf(stderr, "Invalid filter list\n");
-                return -1;
-            }
+    if (!runner.bench && (save_baseline_path != NULL || compare_path != NULL)) {
+        fprintf(stderr, "--save-baseline and --compare can only be used with --bench\n");
+        return EXIT_ERROR;
+    }
+
+    if (merge && optind >= argc) {
+        fprintf(stderr, "--merge needs the results files to merge\n");
+        return EXIT_ERROR;
+    }
 
-            filters[i] = malloc(filter_len + 2 + 1);
-            snprintf(filters[i], filter_len + 2 + 1, "[%s]", p);
+    if (merge && results_path != NULL) {
+        fprintf(stderr, "--merge and --results can't be used together\n");
+        return EXIT_ERROR;
+    }
 
 #ifdef _WIN32
-            p = strtok_s(NULL, ",", &next_token);
-#else
-            p = strtok_r(NULL, ",", &next_token);
+    if (num_fork_workers > 0) {
+        fprintf(stderr, "--fork-workers is not supported on Windows\n");
+        return EXIT_ERROR;
+    }
+
+    if (baro__c.fork_subtests) {
+        fprintf(stderr, "--fork-subtests is not supported on Windows\n");
+        return EXIT_ERROR;
+    }
 #endif
+
+    struct test_ids test_ids = {0};
+    if (ids_path != NULL || list_tests || discover_path != NULL || trees_path != NULL ||
+        runner.format != FORMAT_TEXT || results_path != NULL || merge ||
+        save_baseline_path != NULL || compare_path != NULL) {
+        test_ids_create(&test_ids, &baro__tests);
+    }
+    runner.ids = &test_ids;
+
+    // Results are merged in place of running any tests
+    if (merge) {
+        size_t const num_paths = (size_t) (argc - optind);
+        if (runner.format == FORMAT_TEXT) {
+            printf("Merging the results of %zu file%s\n", num_paths, num_paths > 1 ? "s" : "");
         }
+        print_header();
 
-        // Copy over tests that match the filters
-        for (size_t i = 0; i < total_num_tests; i++) {
-            struct baro__test const *test = &baro__c.tests.tests[i];
+        int const status = merge_results(argv + optind, num_paths);
 
-            for (size_t j = 0; j < num_filters; j++) {
-                char const *filter = filters[j];
-                if (filter != NULL && strstr(test->tag->desc, filter) != NULL) {
-                    baro__test_list_add(&tests, test);
-                    break;
-                }
+        print_summary();
+        if (runner.format == FORMAT_TAP) {
+            printf("1..%zu\n", baro__c.num_tests_ran);
+        }
+
+        test_ids_destroy(&test_ids);
+        free(raw_tag_filters);
+        free(raw_path);
+        return status;
+    }
+
+    struct baseline_table baseline = {0};
+    if (compare_path != NULL) {
+        if (!baseline_table_load(&baseline, compare_path)) {
+            fprintf(stderr, "Failed to read benchmark baselines from %s\n", compare_path);
+            test_ids_destroy(&test_ids);
+            free(raw_tag_filters);
+            free(raw_path);
+            return EXIT_ERROR;
+        }
+        runner.baseline = &baseline;
+    }
+
+    struct baro__test_list candidates = baro__tests;
+    if (ids_path != NULL) {
+        struct test_id_set ids = {0};
+        if (!test_id_set_load(&ids, ids_path)) {
+            test_id_set_destroy(&ids);
+            test_ids_destroy(&test_ids);
+            return EXIT_ERROR;
+        }
+
+        baro__test_list_create(&candidates, ids.size > 0 ? ids.size : 1);
+        for (size_t i = 0; i < baro__tests.size; i++) {
+            if (test_id_set_match(&ids, test_ids_find(&test_ids, baro__tests.tests[i].tag))) {
+                baro__test_list_add(&candidates, &baro__tests.tests[i]);
             }
         }
 
-        // Clean up
-        for (size_t i = 0; i < num_filters; i++) {
-            if (filters[i] != NULL) {
-                free(filters[i]);
+        for (size_t i = 0; i < ids.capacity; i++) {
+            if (ids.states[i] == TEST_ID_UNMATCHED) {
+                fprintf(stderr, "No test has the ID %016llx\n", (unsigned long long) ids.ids[i]);
             }
         }
-        free(filters);
 
+        test_id_set_destroy(&ids);
+    }
+
+    // Filter out tests. Naming a test with --ids or --path runs it even when
+    // it is hidden.
+    int const named_tests = ids_path != NULL || raw_path != NULL;
+    struct baro__test_list tests;
+    if (raw_tag_filters != NULL && raw_tag_filters[0] != '\0') {
+        struct tag_expr expr;
+        if (!tag_expr_compile(&expr, raw_tag_filters)) {
+            fprintf(stderr, "Invalid tag expression: %s at column %zu\n",
+                    expr.error, (size_t) (expr.p - expr.source) + 1);
+            tag_expr_destroy(&expr);
+            free(raw_tag_filters);
+            return EXIT_ERROR;
+        }
+
+        select_tests(&expr, expr.names_hidden || named_tests, runner.bench, &candidates, &tests);
+
+        tag_expr_destroy(&expr);
         free(raw_tag_filters);
         raw_tag_filters = NULL;
     } else {
-        memcpy(&tests, &baro__c.tests, sizeof(baro__c.tests));
+        select_tests(NULL, named_tests, runner.bench, &candidates, &tests);
+    }
+
+    if (candidates.tests != baro__tests.tests && candidates.tests != tests.tests) {
+        free(candidates.tests);
+    }
+
+    // A path starts with the description of the test to run, followed by
+    // those of the subtests to take, separated by '>'
+    if (raw_path != NULL) {
+        size_t num_parts = 1;
+        for (char const *p = raw_path; *p; p++) {
+            if (*p == '>') {
+                num_parts++;
+            }
+        }
+
+        path_parts = malloc(num_parts * sizeof(char *));
+        path_parts[0] = raw_path;
+        for (size_t i = 1; i < num_parts; i++) {
+            char * const separator = strchr(path_parts[i - 1], '>');
+            *separator = '\0';
+            path_parts[i] = separator + 1;
+        }
+
+        struct baro__test_list matching;
+        baro__test_list_create(&matching, 1);
+        for (size_t i = 0; i < tests.size; i++) {
+            if (strcmp(tests.tests[i].tag->desc, path_parts[0]) == 0) {
+                baro__test_list_add(&matching, &tests.tests[i]);
+            }
+        }
+
+        if (tests.tests != baro__tests.tests) {
+            free(tests.tests);
+        }
+        tests = matching;
+
+        runner.subtest_filter = path_parts + 1;
+        runner.subtest_filter_size = num_parts - 1;
+        baro__c.subtest_filter = (char const * const *) runner.subtest_filter;
+        baro__c.subtest_filter_size = runner.subtest_filter_size;
     }
 
     size_t const num_tests = tests.size;
     if (num_tests > 0 && (num_partitions < 1 || num_partitions > num_tests)) {
         fprintf(stderr, "Invalid number of partitions %zu, value should be"
                         "between 1 and %zu\n", num_partitions, num_tests);
-        return -1;
+        return EXIT_ERROR;
     }
 
     if (cur_partition < 1 || cur_partition > num_partitions) {
         fprintf(stderr, "Invalid current partition %zu, value should between 1"
                         " and %zu inclusive\n", cur_partition, num_partitions);
-        return -1;
+        return EXIT_ERROR;
     }
 
     // Sort the list of tests so that we get a deterministic order of execution
     // across different compilers and runtimes
     baro__test_list_sort(&tests);
 
+    if (list_tests) {
+        for (size_t i = 0; i < tests.size; i++) {
+            struct baro__tag const * const tag = tests.tests[i].tag;
+            printf("%016llx\t%s:%d\t%s\n", (unsigned long long) test_ids_find(&test_ids, tag),
+                   extract_file_name(tag->file_path), tag->line_num, tag->desc);
+        }
+        test_ids_destroy(&test_ids);
+
+        if (tests.tests != baro__tests.tests) {
+            free(tests.tests);
+        }
+        free(path_parts);
+        free(raw_path);
+        return 0;
+    }
+
+    struct duration_table durations = {0};
+    int const have_durations = durations_path != NULL &&
+                               duration_table_load(&durations, durations_path);
+
+    struct tree_table trees = {0};
+    int const have_trees = trees_path != NULL && tree_table_load(&trees, trees_path);
+    if (trees_path != NULL && !have_trees) {
+        fprintf(stderr, "Failed to read subtest trees from %s\n", trees_path);
+    }
+
+    // Discovering adds to the trees from earlier runs
+    struct tree_table discovered = {0};
+    if (discover_path != NULL) {
+        tree_table_load(&discovered, discover_path);
+    }
+
     // Partition the tests if we are in a multiprocess workflow
-    size_t const partition_size = (num_tests + (num_partitions - 1)) / num_partitions;
-    size_t const first_test = partition_size * (cur_partition - 1);
-    size_t last_test = first_test + partition_size;
-    if (last_test >= num_tests) {
-        last_test = num_tests;
+    struct baro__test *tests_to_run;
+    struct baro__test *planned_tests = NULL;
+    size_t num_tests_to_run;
+    if (num_partitions > 1 && (have_durations || have_trees)) {
+        // The number of passes a test takes stands in for how long it takes,
+        // until its duration is known
+        uint64_t * const weights = have_durations
+                                   ? duration_weights(tests.tests, num_tests, &durations)
+                                   : leaf_weights(tests.tests, num_tests, &trees, &test_ids);
+
+        size_t * const assignments = calloc(num_tests, sizeof(size_t));
+        plan_partitions(weights, num_tests, num_partitions, assignments);
+
+        tests_to_run = planned_tests = calloc(num_tests, sizeof(struct baro__test));
+        num_tests_to_run = 0;
+        uint64_t partition_weight = 0;
+        for (size_t i = 0; i < num_tests; i++) {
+            if (assignments[i] == cur_partition - 1) {
+                tests_to_run[num_tests_to_run++] = tests.tests[i];
+                partition_weight += weights[i];
+            }
+        }
+
+        if (runner.format == FORMAT_TEXT) {
+            printf("Running %zu out of %zu test%s (of %zu total)\n", num_tests_to_run, num_tests,
+                   num_tests > 1 ? "s" : "", total_num_tests);
+            if (have_durations) {
+                printf("(Partition %zu: planned from %s, about %.3f s)\n", cur_partition,
+                       durations_path, partition_weight / 1e6);
+            } else {
+                printf("(Partition %zu: planned from %s, about %llu passes)\n", cur_partition,
+                       trees_path, (unsigned long long) partition_weight);
+            }
+        }
+
+        free(assignments);
+        free(weights);
+    } else {
+        size_t const partition_size = (num_tests + (num_partitions - 1)) / num_partitions;
+        size_t const first_test = partition_size * (cur_partition - 1);
+        size_t last_test = first_test + partition_size;
+        if (last_test >= num_tests) {
+            last_test = num_tests;
+        }
+
+        tests_to_run = &tests.tests[first_test];
+        num_tests_to_run = last_test - first_test;
+
+        if (runner.format == FORMAT_TEXT) {
+            printf("Running %zu out of %zu test%s (of %zu total)\n", num_tests_to_run, num_tests,
+                   num_tests > 1 ? "s" : "", total_num_tests);
+            if (num_partitions > 1) {
+                printf("(Partition %zu: tests %zu through %zu)\n", cur_partition, first_test + 1, last_test);
+            }
+        }
     }
 
-    size_t const num_tests_to_run = last_test - first_test;
-    printf("Running %zu out of %zu test%s (of %zu total)\n", num_tests_to_run, num_tests,
-           num_tests > 1 ? "s" : "", total_num_tests);
-    if (num_partitions > 1) {
-        printf("(Partition %zu: tests %zu through %zu)\n", cur_partition, first_test + 1, last_test);
+    print_header();
+    if (runner.format == FORMAT_TAP) {
+        printf("1..%zu\n", num_tests_to_run);
     }
 
-    printf(BARO__SEPARATOR);
+    runner.tests = tests_to_run;
+
+    if (results_path != NULL) {
+        runner.results_fd = results_open(results_path);
+        if (runner.results_fd == -1) {
+            fprintf(stderr, "Failed to write results to %s\n", results_path);
+            return EXIT_ERROR;
+        }
+    }
+
+    runner.results = calloc(num_tests_to_run + 1, sizeof(struct test_result));
+    if (runner.num_slowest > 0) {
+        runner.slowest_leaves = calloc(runner.num_slowest, sizeof(struct leaf_timing));
+        mutex_create(&runner.slowest_lock);
+    }
 
-    baro__redirect_output(&baro__c, suppress_stdout);
+#ifndef _WIN32
+    // Unless all output is shown as-is, stderr is kept along with stdout. With
+    // -j, the output of tests running at the same time can't be told apart,
+    // so stderr is left alone to keep showing diagnostics as they're written.
+    baro__c.capture_stderr = runner.suppress_stdout && !suppress_stderr && num_threads == 1;
+    if (!suppress_stderr) {
+        original_stderr = fcntl(fileno(stderr), F_DUPFD_CLOEXEC, 3);
+    }
+    if (num_fork_workers == 0) {
+        set_crash_handlers();
+    }
+#endif
+    baro__redirect_output(&baro__c, runner.suppress_stdout);
     if (suppress_stderr) {
         baro__disable_output(&baro__c, stderr);
     }
 
-    // Begin running tests serially
-    for (size_t i = first_test; i < last_test; i++) {
-        struct baro__test const * const test = &tests.tests[i];
-        baro__c.current_test = test;
-        baro__c.current_test_failed = 0;
-        baro__hash_set_clear(&baro__c.passed_subtests);
+    if (num_threads > 1 && num_tests_to_run > 0) {
+        uint64_t * const weights = have_trees
+                                   ? leaf_weights(tests_to_run, num_tests_to_run, &trees, &test_ids)
+                                   : NULL;
+        run_tests_in_parallel(tests_to_run, weights, num_tests_to_run, num_threads);
+        free(weights);
+#ifndef _WIN32
+    } else if (num_fork_workers > 0 && num_tests_to_run > 0) {
+        run_tests_in_processes(tests_to_run, num_tests_to_run, num_fork_workers);
+#endif
+    } else {
+        for (size_t i = 0; i < num_tests_to_run; i++) {
+            int const failed = run_test(&tests_to_run[i], &runner.results[i]);
 
-        int run_test = 1;
+            // A test cut short by a REQUIRE failure may not have found all of
+            // its subtests, so its previous tree is kept instead
+            if (discover_path != NULL && !runner.results[i].aborted) {
+                tree_table_set(&discovered, test_ids_find(&test_ids, tests_to_run[i].tag),
+                               subtest_tree_shape(&baro__c.subtests));
+            }
 
-        int const jmp_val = setjmp(baro__c.env);
-        // Recover from REQUIRE assertion failures
-        if (jmp_val == BARO__JMP_REQUIRE) {
-            run_test = 0;
+            if (failed && runner.stop_after_failure) {
+                break;
+            }
         }
-        // Recover from SIGABRT failures
-        else if (jmp_val == BARO__JMP_SIGABRT) {
-            baro__c.current_test_failed = 1;
-            baro__c.num_asserts_failed++;
+    }
+
+    if (runner.results_fd != -1 && !results_close(runner.results_fd)) {
+        fprintf(stderr, "Failed to write results to %s\n", results_path);
+    }
+    runner.results_fd = -1;
 
-            baro__redirect_output(&baro__c, 0);
+    if (discover_path != NULL && !tree_table_save(&discovered, discover_path)) {
+        fprintf(stderr, "Failed to write subtest trees to %s\n", discover_path);
+    }
+    tree_table_destroy(&discovered);
+    tree_table_destroy(&trees);
 
-            printf(BARO__RED "Assertion failed! Caught SIGABRT\n" BARO__UNSET_COLOR);
-            baro__assert_failed(BARO__ASSERT_REQUIRE, 0);
+    if (durations_path != NULL) {
+        if (num_partitions > 1) {
+            // Only record this partition's tests, so that the files written by
+            // all partitions can be concatenated for the next run
+            duration_table_destroy(&durations);
+            durations = (struct duration_table){0};
+        }
 
-            run_test = 0;
+        for (size_t i = 0; i < num_tests_to_run; i++) {
+            if (runner.results[i].ran) {
+                duration_table_set(&durations, duration_key(&tests_to_run[i]),
+                                   runner.results[i].duration_ns / 1000);
+            }
         }
-        // Otherwise, install a SIGABRT handler
-        else {
-            set_sigabrt_handler(handle_signal);
+
+        if (!duration_table_save(&durations, durations_path)) {
+            fprintf(stderr, "Failed to write durations to %s\n", durations_path);
         }
+    }
+    duration_table_destroy(&durations);
 
-        while (run_test) {
-            // Reset the current subtest stack
-            baro__c.should_reenter_subtest = 0;
-            baro__c.subtest_max_size = 0;
-            baro__tag_list_clear(&baro__c.subtest_stack);
+    baro__redirect_output(&baro__c, 0);
 
-            test->func();
+    // Only benchmarks that passed make it into the baseline, so that one
+    // which regressed is still compared against the last good run
+    if (save_baseline_path != NULL) {
+        struct baseline_table saved = {0};
+        baseline_table_load(&saved, save_baseline_path);
 
-            // Keep looping until all subtest permutations have been visited
-            if (!baro__c.should_reenter_subtest) {
-                run_test = 0;
+        for (size_t i = 0; i < num_tests_to_run; i++) {
+            struct test_result const * const result = &runner.results[i];
+            if (!result->ran || result->failed || result->bench_num_samples == 0) {
+                continue;
             }
+
+            struct baro__tag const * const tag = tests_to_run[i].tag;
+            struct baseline_entry entry = {
+                    .id = test_ids_find(&test_ids, tag),
+                    .line_num = tag->line_num,
+                    .num_samples = result->bench_num_samples,
+            };
+            char const * const file_name = extract_file_name(tag->file_path);
+            entry.file_name = copy_string(file_name, strlen(file_name));
+            entry.desc = copy_string(tag->desc, strlen(tag->desc));
+            memcpy(entry.samples, result->bench_samples, result->bench_num_samples * sizeof(double));
+            baseline_table_set(&saved, &entry, tag);
         }
 
-        baro__c.num_tests_ran++;
-        if (baro__c.current_test_failed) {
-            baro__c.num_tests_failed++;
-            if (stop_after_failure) {
-                break;
+        if (!baseline_table_save(&saved, save_baseline_path)) {
+            fprintf(stderr, "Failed to write benchmark baselines to %s\n", save_baseline_path);
+        }
+        baseline_table_destroy(&saved);
+    }
+
+    // Baselines left over after every benchmark in the suite has been looked
+    // for, and not just those that ran, belong to ones that are gone
+    if (compare_path != NULL) {
+        for (size_t i = 0; i < baro__tests.size; i++) {
+            struct baro__tag const * const tag = baro__tests.tests[i].tag;
+            struct baseline_entry * const entry = baro__tests.tests[i].bench
+                                                  ? baseline_table_find(&baseline, test_ids_find(&test_ids, tag), tag)
+                                                  : NULL;
+            if (entry != NULL) {
+                entry->matched = 1;
             }
-        } else if (show_passed_tests) {
-            baro__redirect_output(&baro__c, 0);
+        }
 
-            printf(BARO__GREEN "Passed: %s (%s:%d)\n" BARO__UNSET_COLOR BARO__SEPARATOR,
-                   test->tag->desc, extract_file_name(test->tag->file_path), test->tag->line_num);
-            baro__redirect_output(&baro__c, suppress_stdout);
+        for (size_t i = 0; i < baseline.size; i++) {
+            struct baseline_entry const * const entry = &baseline.entries[i];
+            if (!entry->matched) {
+                fprintf(stderr, "No benchmark has the baseline %016llx of \"%s\" (%s:%d), "
+                                "it may have been renamed and moved\n",
+                        (unsigned long long) entry->id, entry->desc, entry->file_name, entry->line_num);
+            }
         }
+    }
 
-        // Wipe the saved output between tests
-        memset(baro__c.stdout_buffer, 0, BARO__STDOUT_BUF_SIZE);
+    if (runner.num_slowest > 0) {
+        print_slowest(tests_to_run, num_tests_to_run);
+        free(runner.slowest_leaves);
+        mutex_destroy(&runner.slowest_lock);
     }
 
-    baro__redirect_output(&baro__c, 0);
+    free(planned_tests);
+    if (tests.tests != baro__tests.tests) {
+        free(tests.tests);
+    }
+    test_ids_destroy(&test_ids);
+    free(path_parts);
+    free(raw_path);
+    for (size_t i = 0; i < num_tests_to_run; i++) {
+        free(runner.results[i].bench_samples);
+    }
+    free(runner.results);
+    baseline_table_destroy(&baseline);
+    runner.baseline = NULL;
+    close_counters();
+    delete_timer();
 
-    printf("tests:   %5zu total | " BARO__GREEN "%5zu passed" BARO__UNSET_COLOR
-           " | " BARO__RED "%5zu failed" BARO__UNSET_COLOR "\n",
-           baro__c.num_tests_ran, baro__c.num_tests_ran - baro__c.num_tests_failed,
-           baro__c.num_tests_failed);
+    print_summary();
 
-    printf("asserts: %5zu total | " BARO__GREEN "%5zu passed" BARO__UNSET_COLOR
-           " | " BARO__RED "%5zu failed" BARO__UNSET_COLOR "\n",
-           baro__c.num_asserts, baro__c.num_asserts - baro__c.num_asserts_failed,
-           baro__c.num_asserts_failed);
+    // Stopping early leaves the rest of the plan unaccounted for
+    if (runner.format == FORMAT_TAP && baro__c.num_tests_ran < num_tests_to_run) {
+        printf("Bail out! Stopped after %zu of %zu tests\n", baro__c.num_tests_ran, num_tests_to_run);
+    }
 
-    return (int) baro__c.num_tests_failed;
+    return baro__c.num_tests_failed > 0 ? EXIT_FAILED : EXIT_PASSED;
 }
@@ -4,6 +4,7 @@
 #ifdef BARO_ENABLE
 
 #include <setjmp.h>
+#include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -25,8 +26,18 @@ struct baro__tag {
     int line_num;
 };
 
+// Implemented by the test runner. Stops counting allocations against the
+// current test while the buffers below grow, as they belong to the runner.
+// Returns whether counting was on, to be handed to baro__resume_allocs.
+int baro__pause_allocs(void);
+void baro__resume_allocs(int tracking);
+
 struct baro__tag_list {
     struct baro__tag const **tags;
+    // The hash of every prefix of the list, so that pushing a tag only has to
+    // hash that one tag, and popping restores the previous hash for free.
+    // `hashes[i]` covers `tags[0]` through `tags[i]`.
+    uint64_t *hashes;
     size_t size;
     size_t capacity;
 };
@@ -35,10 +46,17 @@ static inline void baro__tag_list_create(
         struct baro__tag_list * const list,
         size_t const capacity) {
     list->tags = calloc(capacity, sizeof(struct baro__tag *));
+    list->hashes = calloc(capacity, sizeof(uint64_t));
     list->size = 0;
     list->capacity = capacity;
 }
 
+static inline void baro__tag_list_destroy(
+        struct baro__tag_list * const list) {
+    free(list->tags);
+    free(list->hashes);
+}
+
 static inline size_t baro__tag_list_size(
         struct baro__tag_list * const list) {
     return list->size;
@@ -49,6 +67,35 @@ static inline void baro__tag_list_clear(
     list->size = 0;
 }
 
+// Adapted from MurmurHash3's avalanche mixer
+static inline uint64_t baro__mix64(
+        uint64_t a) {
+    a ^= a >> 33u;
+    a *= 0xff51afd7ed558ccdL;
+    a ^= a >> 33u;
+    a *= 0xc4ceb9fe1a85ec53L;
+    a ^= a >> 33u;
+    return a;
+}
+
+static inline uint64_t baro__tag_hash(
+        struct baro__tag const * const tag,
+        size_t const index) {
+    // Use the address of each item in the list as build a hash, as we only
+    // expect tags to be statically allocated. The C99 standard guarantees that
+    // two named objects of the same type will not have the same memory
+    // location (6.5.9/6):
+    //
+    // > Two pointers compare equal if and only if both are null pointers,
+    // > both are pointers to the same object (including a pointer to an object
+    // > and a subobject at its beginning) or function, both are pointers to
+    // > one past the last element of the same array object, or one is a pointer
+    // > to one past the end of one array object and the other is a pointer to
+    // > the start of a different array object that happens to immediately
+    // > follow the first array object in the address space.
+    return baro__mix64((uint64_t) tag + index);
+}
+
 static inline void baro__tag_list_push(
         struct baro__tag_list * const list,
         struct baro__tag const * const tag) {
@@ -56,15 +103,23 @@ static inline void baro__tag_list_push(
         list->capacity *= 2;
 
         struct baro__tag const ** const old_tags = list->tags;
+        uint64_t * const old_hashes = list->hashes;
 
+        int const tracking = baro__pause_allocs();
         list->tags = calloc(list->capacity, sizeof(struct baro__tag *));
+        list->hashes = calloc(list->capacity, sizeof(uint64_t));
         for (size_t i = 0; i < list->size; i++) {
             list->tags[i] = old_tags[i];
+            list->hashes[i] = old_hashes[i];
         }
 
         free(old_tags);
+        free(old_hashes);
+        baro__resume_allocs(tracking);
     }
 
+    uint64_t const parent_hash = list->size > 0 ? list->hashes[list->size - 1] : 0;
+    list->hashes[list->size] = parent_hash ^ baro__tag_hash(tag, list->size);
     list->tags[list->size++] = tag;
 }
 
@@ -85,130 +140,144 @@ static inline int baro__tag_list_pop(
 
 static inline uint64_t baro__tag_list_hash(
         struct baro__tag_list * const list) {
-    uint64_t hash = 0;
+    return list->size > 0 ? list->hashes[list->size - 1] : 0;
+}
 
-    // Use the address of each item in the list as build a hash, as we only
-    // expect tags to be statically allocated. The C99 standard guarantees that
-    // two named objects of the same type will not have the same memory
-    // location (6.5.9/6):
-    //
-    // > Two pointers compare equal if and only if both are null pointers,
-    // > both are pointers to the same object (including a pointer to an object
-    // > and a subobject at its beginning) or function, both are pointers to
-    // > one past the last element of the same array object, or one is a pointer
-    // > to one past the end of one array object and the other is a pointer to
-    // > the start of a different array object that happens to immediately
-    // > follow the first array object in the address space.
-    for (size_t i = 0; i < list->size; i++) {
-        // Adapted from MurmurHash3's avalanche mixer
-        uint64_t a = (uint64_t) list->tags[i] + i;
-        a ^= a >> 33u;
-        a *= 0xff51afd7ed558ccdL;
-        a ^= a >> 33u;
-        a *= 0xc4ceb9fe1a85ec53L;
-        a ^= a >> 33u;
-        hash ^= a;
-    }
+// Every subtest path discovered in the current test, as a tree of tags.
+// Nodes live in a single pool and refer to each other by index, with the root
+// at index 0, which also stands for "no node" in the links.
+struct baro__subtest_node {
+    struct baro__tag const *tag;
 
-    return hash;
-}
+    size_t parent;
+    size_t first_child;
+    size_t next_sibling;
 
-struct baro__hash_set {
-    size_t nbits;
-    uint64_t mask;
+    // Set once the subtest and everything nested in it have run
+    int done;
+};
 
-    size_t capacity;
+struct baro__subtest_trie {
+    struct baro__subtest_node *nodes;
     size_t size;
+    size_t capacity;
 
-    uint64_t *hashes;
+    // Open addressing from (parent, tag) to every node but the root, with
+    // twice as many slots as there are nodes, as a test may have so many
+    // subtests side by side that walking the siblings adds up
+    size_t *index;
 };
 
-static inline void baro__hash_set_create(
-        struct baro__hash_set * const set) {
-    set->nbits = 4;
-    set->capacity = 1llu << set->nbits;
-    set->mask = set->capacity - 1;
-
-    set->hashes = calloc(set->capacity, sizeof(uint64_t));
-    set->size = 0;
+static inline void baro__subtest_trie_create(
+        struct baro__subtest_trie * const trie) {
+    trie->capacity = 16;
+    trie->nodes = calloc(trie->capacity, sizeof(struct baro__subtest_node));
+    trie->index = calloc(trie->capacity * 2, sizeof(size_t));
+    trie->size = 1;
 }
 
-static inline void baro__hash_set_clear(
-        struct baro__hash_set * const set) {
-    set->size = 0;
-    memset(set->hashes, 0, set->capacity * sizeof(uint64_t));
+static inline void baro__subtest_trie_destroy(
+        struct baro__subtest_trie * const trie) {
+    free(trie->nodes);
+    free(trie->index);
 }
 
-static const uint64_t hash_set_prime_1 = 73;
-static const uint64_t hash_set_prime_2 = 5009;
-
-static inline void baro__hash_set_add_only(
-        struct baro__hash_set * const set,
-        uint64_t const hash) {
-    uint64_t index = set->mask & (hash_set_prime_1 * hash);
+static inline size_t baro__subtest_trie_slot(
+        struct baro__subtest_trie const * const trie,
+        size_t const parent,
+        struct baro__tag const * const tag) {
+    uint64_t const hash = baro__mix64((uint64_t) (uintptr_t) tag ^ (uint64_t) parent * 0x9e3779b97f4a7c15ull);
+    return (size_t) hash & (trie->capacity * 2 - 1);
+}
 
-    while (set->hashes[index]) {
-        if (set->hashes[index] == hash) {
-            return;
+static inline void baro__subtest_trie_clear(
+        struct baro__subtest_trie * const trie) {
+    // Only the slots of the nodes that were added are emptied, so that a test
+    // with many subtests doesn't make clearing slower for every later test.
+    // Each node is certain to be found by probing from its own slot, even when
+    // slots before it have been emptied already.
+    size_t const mask = trie->capacity * 2 - 1;
+    for (size_t node = 1; node < trie->size; node++) {
+        size_t slot = baro__subtest_trie_slot(trie, trie->nodes[node].parent, trie->nodes[node].tag);
+        while (trie->index[slot] != node) {
+            slot = (slot + 1) & mask;
         }
-
-        index = set->mask & (index + hash_set_prime_2);
+        trie->index[slot] = 0;
     }
 
-    set->size++;
-    set->hashes[index] = hash;
+    // Nodes past the root are unreachable once it has no children, so they
+    // can simply be overwritten by the next test
+    trie->size = 1;
+    memset(&trie->nodes[0], 0, sizeof(struct baro__subtest_node));
 }
 
-static inline void baro__hash_set_grow(
-        struct baro__hash_set * const set) {
-    if ((int) set->size > (double) set->capacity * 0.85) {
-        uint64_t *prev_hashes = set->hashes;
-        size_t prev_capacity = set->capacity;
-
-        set->nbits++;
-        set->capacity = 1llu << set->nbits;
-        set->mask = set->capacity - 1;
-
-        set->hashes = calloc(set->capacity, sizeof(uint64_t));
-        set->size = 0;
-        for (size_t i = 0; i < prev_capacity; i++) {
-            if (prev_hashes[i] == 0) {
-                continue;
-            }
-
-            baro__hash_set_add_only(set, prev_hashes[i]);
+// Returns the child of `parent` for the given subtest, or 0 if it hasn't been
+// discovered yet
+static inline size_t baro__subtest_trie_find(
+        struct baro__subtest_trie * const trie,
+        size_t const parent,
+        struct baro__tag const * const tag) {
+    size_t const mask = trie->capacity * 2 - 1;
+    size_t slot = baro__subtest_trie_slot(trie, parent, tag);
+    for (size_t child = trie->index[slot]; child != 0; child = trie->index[slot]) {
+        if (trie->nodes[child].parent == parent && trie->nodes[child].tag == tag) {
+            return child;
         }
-        free(prev_hashes);
+        slot = (slot + 1) & mask;
     }
+
+    return 0;
 }
 
-static inline void baro__hash_set_add(
-        struct baro__hash_set * const set,
-        uint64_t const hash) {
-    baro__hash_set_add_only(set, hash);
-    baro__hash_set_grow(set);
+static inline void baro__subtest_trie_index(
+        struct baro__subtest_trie * const trie,
+        size_t const node) {
+    size_t const mask = trie->capacity * 2 - 1;
+    size_t slot = baro__subtest_trie_slot(trie, trie->nodes[node].parent, trie->nodes[node].tag);
+    while (trie->index[slot] != 0) {
+        slot = (slot + 1) & mask;
+    }
+    trie->index[slot] = node;
 }
 
-static inline int baro__hash_set_contains(
-        struct baro__hash_set * const set,
-        uint64_t const hash) {
-    uint64_t index = set->mask & (hash_set_prime_1 * hash);
+static inline size_t baro__subtest_trie_add(
+        struct baro__subtest_trie * const trie,
+        size_t const parent,
+        struct baro__tag const * const tag) {
+    if (trie->size == trie->capacity) {
+        trie->capacity *= 2;
 
-    while (set->hashes[index]) {
-        if (set->hashes[index] == hash) {
-            return 1;
-        }
+        int const tracking = baro__pause_allocs();
+        trie->nodes = realloc(trie->nodes, trie->capacity * sizeof(struct baro__subtest_node));
+        free(trie->index);
+        trie->index = calloc(trie->capacity * 2, sizeof(size_t));
+        baro__resume_allocs(tracking);
 
-        index = set->mask & (index + hash_set_prime_2);
+        for (size_t i = 1; i < trie->size; i++) {
+            baro__subtest_trie_index(trie, i);
+        }
     }
 
-    return 0;
+    size_t const child = trie->size++;
+    struct baro__subtest_node * const node = &trie->nodes[child];
+    node->tag = tag;
+    node->parent = parent;
+    node->first_child = 0;
+    node->next_sibling = trie->nodes[parent].first_child;
+    node->done = 0;
+
+    trie->nodes[parent].first_child = child;
+    baro__subtest_trie_index(trie, child);
+    return child;
 }
 
 struct baro__test {
     const struct baro__tag *tag;
 
     void (*func)(void);
+
+    // Benchmarks are only run with --bench, and tests only without it
+    int bench;
 };
 
 struct baro__test_list {
@@ -244,30 +313,223 @@ static inline void baro__test_list_add(
     list->tests[list->size++] = *test;
 }
 
-static int baro__test_list_sort_cmp(
+// A distinct file path, along with its index in the list of distinct paths
+struct baro__file_path {
+    char const *path;
+    size_t id;
+};
+
+static int baro__file_path_cmp(
         void const *lhs,
         void const *rhs) {
-    struct baro__test const * const lhs_test = lhs;
-    struct baro__test const * const rhs_test = rhs;
+    struct baro__file_path const * const lhs_path = lhs;
+    struct baro__file_path const * const rhs_path = rhs;
+    return strcmp(lhs_path->path, rhs_path->path);
+}
 
-    int const file_name_cmp = strcmp(lhs_test->tag->file_path, rhs_test->tag->file_path);
-    if (file_name_cmp != 0) {
-        return file_name_cmp;
+// Sorts `keys` along with `indices`. The sort is stable, and skips every byte
+// that is the same across all keys.
+static inline void baro__radix_sort(
+        uint64_t * const keys,
+        size_t * const indices,
+        size_t const size) {
+    if (size < 2) {
+        return;
     }
 
-    return lhs_test->tag->line_num - rhs_test->tag->line_num;
+    uint64_t * const scratch_keys = malloc(size * sizeof(uint64_t));
+    size_t * const scratch_indices = malloc(size * sizeof(size_t));
+
+    uint64_t *from_keys = keys, *to_keys = scratch_keys;
+    size_t *from_indices = indices, *to_indices = scratch_indices;
+    for (unsigned shift = 0; shift < 64; shift += 8) {
+        size_t counts[256] = {0};
+        for (size_t i = 0; i < size; i++) {
+            counts[(from_keys[i] >> shift) & 0xff]++;
+        }
+        if (counts[(from_keys[0] >> shift) & 0xff] == size) {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (size_t digit = 0; digit < 256; digit++) {
+            size_t const count = counts[digit];
+            counts[digit] = offset;
+            offset += count;
+        }
+
+        for (size_t i = 0; i < size; i++) {
+            size_t const j = counts[(from_keys[i] >> shift) & 0xff]++;
+            to_keys[j] = from_keys[i];
+            to_indices[j] = from_indices[i];
+        }
+
+        uint64_t * const swap_keys = from_keys;
+        from_keys = to_keys;
+        to_keys = swap_keys;
+
+        size_t * const swap_indices = from_indices;
+        from_indices = to_indices;
+        to_indices = swap_indices;
+    }
+
+    // Every pass moves the keys over to the other array, so the result may
+    // have been left in the scratch space
+    if (from_keys != keys) {
+        memcpy(keys, from_keys, size * sizeof(uint64_t));
+        memcpy(indices, from_indices, size * sizeof(size_t));
+    }
+
+    free(scratch_keys);
+    free(scratch_indices);
 }
 
+// Sorts the tests by file path, and then by line number. Comparing paths over
+// and over is slow with many tests, so each distinct path is ranked once, and
+// the tests are radix sorted on their rank and line number packed together.
 static inline void baro__test_list_sort(
         struct baro__test_list * const list) {
-    qsort(list->tests, list->size, sizeof(list->tests[0]), baro__test_list_sort_cmp);
+    size_t const size = list->size;
+    if (size < 2) {
+        return;
+    }
+
+    // Tests in the same file nearly always share a single path string, so
+    // paths are first told apart by address, and only the distinct addresses
+    // are compared as strings
+    size_t capacity = 16;
+    while (capacity < size * 2) {
+        capacity *= 2;
+    }
+
+    struct baro__file_path * const table = calloc(capacity, sizeof(struct baro__file_path));
+    struct baro__file_path * const paths = malloc(size * sizeof(struct baro__file_path));
+    size_t * const path_ids = malloc(size * sizeof(size_t));
+    size_t num_paths = 0;
+
+    for (size_t i = 0; i < size; i++) {
+        char const * const path = list->tests[i].tag->file_path;
+
+        size_t slot = (size_t) (((uint64_t) (uintptr_t) path >> 3) * 0x9e3779b97f4a7c15ull) & (capacity - 1);
+        while (table[slot].path != NULL && table[slot].path != path) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+
+        if (table[slot].path == NULL) {
+            table[slot].path = path;
+            table[slot].id = num_paths;
+            paths[num_paths] = table[slot];
+            num_paths++;
+        }
+        path_ids[i] = table[slot].id;
+    }
+
+    // Identical paths at different addresses share a rank
+    qsort(paths, num_paths, sizeof(struct baro__file_path), baro__file_path_cmp);
+
+    uint64_t * const ranks = malloc(num_paths * sizeof(uint64_t));
+    uint64_t rank = 0;
+    for (size_t i = 0; i < num_paths; i++) {
+        if (i > 0 && strcmp(paths[i].path, paths[i - 1].path) != 0) {
+            rank++;
+        }
+        ranks[paths[i].id] = rank;
+    }
+
+    uint64_t * const keys = malloc(size * sizeof(uint64_t));
+    size_t * const indices = malloc(size * sizeof(size_t));
+    for (size_t i = 0; i < size; i++) {
+        keys[i] = ranks[path_ids[i]] << 32u | (uint32_t) list->tests[i].tag->line_num;
+        indices[i] = i;
+    }
+
+    baro__radix_sort(keys, indices, size);
+
+    struct baro__test * const sorted = malloc(size * sizeof(struct baro__test));
+    for (size_t i = 0; i < size; i++) {
+        sorted[i] = list->tests[indices[i]];
+    }
+    memcpy(list->tests, sorted, size * sizeof(struct baro__test));
+
+    free(sorted);
+    free(indices);
+    free(keys);
+    free(ranks);
+    free(path_ids);
+    free(paths);
+    free(table);
 }
 
-// Maximum number of bytes to record from stdout per test
+// Number of bytes from the end of a test's stdout to show when it fails, by
+// default
 #define BARO__STDOUT_BUF_SIZE 4096
 
+// Failure reports are formatted into a buffer that is reused from test to
+// test, and which the runner writes out in one go once a test is done
+struct baro__report {
+    char *data;
+    size_t size;
+    size_t capacity;
+};
+
+static inline char *baro__report_reserve(
+        struct baro__report * const report,
+        size_t const size) {
+    if (report->capacity - report->size < size) {
+        size_t capacity = report->capacity ? report->capacity : 4096;
+        while (capacity - report->size < size) {
+            capacity *= 2;
+        }
+        int const tracking = baro__pause_allocs();
+        report->data = realloc(report->data, capacity);
+        baro__resume_allocs(tracking);
+        report->capacity = capacity;
+    }
+    return report->data + report->size;
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((format(printf, 2, 3)))
+#endif
+static inline void baro__report_printf(
+        struct baro__report * const report,
+        char const * const format,
+        ...) {
+    char *end = baro__report_reserve(report, 256);
+    size_t const available = report->capacity - report->size;
+
+    va_list args;
+    va_start(args, format);
+    int const size = vsnprintf(end, available, format, args);
+    va_end(args);
+
+    if (size < 0) {
+        return;
+    }
+    // Formatting again is rare, as most lines of a report are short
+    if ((size_t) size >= available) {
+        end = baro__report_reserve(report, (size_t) size + 1);
+        va_start(args, format);
+        vsnprintf(end, (size_t) size + 1, format, args);
+        va_end(args);
+    }
+    report->size += (size_t) size;
+}
+
+// Every worker thread in the test runner gets its own context, so everything
+// touched while a test is executing must be declared thread-local
+#if defined(_MSC_VER)
+#define BARO__THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__) || defined(__clang__)
+#define BARO__THREAD_LOCAL __thread
+#else
+#define BARO__THREAD_LOCAL _Thread_local
+#endif
+
+// All registered tests, shared by every thread
+extern struct baro__test_list baro__tests;
+
 struct baro__context {
-    struct baro__test_list tests;
     struct baro__test const *current_test;
     int current_test_failed;
 
@@ -280,24 +542,115 @@ struct baro__context {
     // A stack that updates as we enter and exit subtests. This is mainly
     // used to build "stack traces" for assertion failures.
     struct baro__tag_list subtest_stack;
-    // A set of all visited subtests in the current test, stored as 64-bit
-    // hashes of the terminating subtest stacks.
-    struct baro__hash_set passed_subtests;
+    // All subtests discovered in the current test, and the node of the
+    // innermost subtest that is currently running.
+    struct baro__subtest_trie subtests;
+    size_t subtest_node;
     size_t subtest_max_size;
     int should_reenter_subtest;
     int subtest_entered;
 
+    // The deepest subtest entered during the current pass, along with when it
+    // was entered and left. This lets the runner tell the time spent in that
+    // leaf apart from the code that every pass re-runs to reach it.
+    struct baro__tag const *leaf;
+    uint64_t leaf_start_ns;
+    uint64_t leaf_end_ns;
+
+    // With --fork-subtests, every subtest runs in a process of its own that
+    // is forked from the one reaching it. `fork_depth` is the depth of the
+    // subtest that the current process was forked to run, or 0 in the runner.
+    int fork_subtests;
+    size_t fork_depth;
+
+    // When tests run on worker threads, every pass through a test is
+    // scheduled on its own. A pass follows `subtest_path` down to the subtest
+    // it was scheduled for, then hands each new sibling it finds below that to
+    // baro__split_subtest rather than coming back for it in another pass.
+    int split_subtests;
+    struct baro__tag const * const *subtest_path;
+    size_t subtest_path_size;
+
+    // Descriptions of the subtests to run down to, selected with --path. No
+    // other subtest is entered on the way.
+    char const * const *subtest_filter;
+    size_t subtest_filter_size;
+
+    // While a benchmark runs, every BENCH_LOOP runs `bench_iterations` times,
+    // and adds the time it took to `bench_elapsed_ns`. A benchmark without a
+    // loop is timed as a whole instead, so `bench_looped` tells them apart.
+    size_t bench_iterations;
+    uint64_t bench_start_ns;
+    uint64_t bench_elapsed_ns;
+    int bench_looped;
+
     jmp_buf env;
 
+    // While stdout is captured, the original is kept in `real_stdout`. On
+    // POSIX, everything written to file descriptor 1 goes to `stdout_capture`,
+    // which is a file in memory that is emptied after every test, and only the
+    // last `stdout_tail_size` bytes of it are read back when a test fails. On
+    // Windows, the last partial buffer of stdout is kept in `stdout_buffer`.
+    //
+    // With `capture_stderr` set, file descriptor 2 goes to the same file on
+    // POSIX, so that both streams end up in a single log in the order they
+    // were written, and the original is kept in `real_stderr`.
     int real_stdout;
-    char stdout_buffer[BARO__STDOUT_BUF_SIZE];
+    int capture_stderr;
+    int real_stderr;
+    int stdout_capture;
+    size_t stdout_tail_size;
+    char *stdout_buffer;
+
+    struct baro__report report;
+};
+
+extern BARO__THREAD_LOCAL struct baro__context baro__c;
+
+// Implemented by the test runner. Reads a monotonic clock, in nanoseconds.
+uint64_t baro__now_ns(void);
+
+// The hardware performance counters that the runner can read
+enum baro__counter {
+    BARO__COUNTER_CYCLES,
+    BARO__COUNTER_INSTRUCTIONS,
+    BARO__COUNTER_BRANCH_MISSES,
+    BARO__COUNTER_CACHE_MISSES,
+    BARO__NUM_COUNTERS,
 };
 
-extern struct baro__context baro__c;
+static char const * const baro__counter_names[BARO__NUM_COUNTERS] = {
+    "cycles", "instructions", "branch misses", "LLC misses",
+};
+
+// Implemented by the test runner. Reads the hardware counters of the calling
+// thread, counting only what runs in user space. Returns a bitmask of the
+// counters that could be read, which is zero where the platform, or its
+// permissions, don't allow counting.
+unsigned baro__read_counters(uint64_t values[BARO__NUM_COUNTERS]);
+// Implemented by the test runner. Starts, or with `stop` set, stops counting
+// the iterations of a benchmark, with --counters.
+void baro__bench_count(int stop);
+
+// Implemented by the test runner. Returns how many allocations the calling
+// thread has made while running tests, or UINT64_MAX when the runner wasn't
+// built with BARO_TRACK_ALLOCS.
+uint64_t baro__num_allocs(void);
+
+// Implemented by the test runner. Forks a process to run the given subtest
+// from the current state. Returns non-zero in the new process, which should
+// enter the subtest, and zero in the original once that process is done.
+int baro__fork_subtest(struct baro__tag const *tag);
+// Implemented by the test runner. Schedules a pass through the current test
+// that takes the current subtest path, followed by the given subtest.
+void baro__split_subtest(struct baro__tag const *tag);
+// Implemented by the test runner. Hands the results of a process started by
+// baro__fork_subtest back to its parent, and exits. `aborted` is non-zero when
+// a failure ended the test, which then ends the parent's run of it too.
+void baro__end_subtest_fork(int aborted);
 
 static inline void baro__context_create(
         struct baro__context * const context) {
-    baro__test_list_create(&context->tests, 128);
     context->current_test = NULL;
     context->current_test_failed = 0;
 
@@ -305,13 +658,45 @@ static inline void baro__context_create(
     context->num_asserts = context->num_asserts_failed = 0;
 
     baro__tag_list_create(&context->subtest_stack, 8);
-    baro__hash_set_create(&context->passed_subtests);
+    baro__subtest_trie_create(&context->subtests);
+    context->subtest_node = 0;
     context->subtest_max_size = 0;
     context->should_reenter_subtest = 0;
     context->subtest_entered = 0;
 
+    context->leaf = NULL;
+    context->leaf_start_ns = context->leaf_end_ns = 0;
+
+    context->fork_subtests = 0;
+    context->fork_depth = 0;
+
+    context->split_subtests = 0;
+    context->subtest_path = NULL;
+    context->subtest_path_size = 0;
+    context->subtest_filter = NULL;
+    context->subtest_filter_size = 0;
+
+    context->bench_iterations = 1;
+    context->bench_start_ns = context->bench_elapsed_ns = 0;
+    context->bench_looped = 0;
+
     context->real_stdout = -1;
-    memset(context->stdout_buffer, 0, BARO__STDOUT_BUF_SIZE);
+    context->capture_stderr = 0;
+    context->real_stderr = -1;
+    context->stdout_capture = -1;
+    context->stdout_tail_size = BARO__STDOUT_BUF_SIZE;
+    context->stdout_buffer = NULL;
+
+    context->report.data = NULL;
+    context->report.size = context->report.capacity = 0;
+}
+
+static inline void baro__context_destroy(
+        struct baro__context * const context) {
+    baro__tag_list_destroy(&context->subtest_stack);
+    baro__subtest_trie_destroy(&context->subtests);
+    free(context->stdout_buffer);
+    free(context->report.data);
 }
 
 #ifdef _WIN32
@@ -322,84 +707,285 @@ static inline void baro__context_create(
 #define strcasecmp _stricmp
 #define fileno _fileno
 #else
+#include <fcntl.h>
 #include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 #endif
 
 static inline void baro__disable_output(
         struct baro__context * const context,
         FILE *file) {
+    (void) context;
+    fflush(file);
 #ifdef _WIN32
     FILE *dummy;
-        if (freopen_s(&dummy, "NUL", "a", file) != 0) {
+    if (freopen_s(&dummy, "NUL", "a", file) != 0) {
+        fprintf(stderr, "Failed to disable output to fileno %d\n", fileno(file));
+        exit(1);
+    }
+    setvbuf(file, NULL, _IONBF, 0);
 #else
-    if (freopen("NUL", "a", file) == NULL) {
-#endif
+    int const null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd < 0 || dup2(null_fd, fileno(file)) < 0) {
         fprintf(stderr, "Failed to disable output to fileno %d\n", fileno(file));
         exit(1);
     }
-    setvbuf(stdout, NULL, _IONBF, 0);
+    close(null_fd);
+#endif
+}
+
+#ifndef _WIN32
+// Opens a file that lives in memory where possible, so that captured output
+// never touches the disk
+static inline int baro__open_memory_file(
+        char const * const name) {
+#if defined(__linux__) && defined(SYS_memfd_create)
+    // MFD_CLOEXEC
+    int const memory_fd = (int) syscall(SYS_memfd_create, name, 1u);
+    if (memory_fd >= 0) {
+        return memory_fd;
+    }
+#else
+    (void) name;
+#endif
+
+    // Otherwise, fall back to a file that is deleted as soon as it's created
+    FILE * const file = tmpfile();
+    if (file == NULL) {
+        return -1;
+    }
+    int const fd = dup(fileno(file));
+    fclose(file);
+    return fd;
 }
+#endif
 
 static inline void baro__redirect_output(
         struct baro__context * const context,
         int const enable) {
     if (enable) {
         fflush(stdout);
-        context->real_stdout = dup(fileno(stdout));
+        if (context->real_stdout == -1) {
+            context->real_stdout = dup(fileno(stdout));
+        }
 #ifdef _WIN32
         FILE *dummy;
         if (freopen_s(&dummy, "NUL", "a", stdout) != 0) {
+            fprintf(stderr, "Failed to redirect stdout\n");
+            exit(1);
+        }
+        if (context->stdout_buffer == NULL) {
+            context->stdout_buffer = calloc(context->stdout_tail_size + 1, 1);
+        }
+        setvbuf(stdout, context->stdout_buffer, _IOFBF, context->stdout_tail_size);
 #else
-        if (freopen("NUL", "a", stdout) == NULL) {
-#endif
+        if (context->stdout_capture == -1) {
+            context->stdout_capture = baro__open_memory_file("baro-stdout");
+
+            // Flush every line, so that it lands in the log in the same order
+            // as what is written to stderr around it. Handing over a buffer
+            // makes the C library start over with it, rather than keep filling
+            // the one it has.
+            static char line_buffer[BUFSIZ];
+            setvbuf(stdout, line_buffer, _IOLBF, sizeof(line_buffer));
+        }
+        if (context->stdout_capture == -1 || dup2(context->stdout_capture, fileno(stdout)) < 0) {
             fprintf(stderr, "Failed to redirect stdout\n");
             exit(1);
         }
-        setvbuf(stdout, baro__c.stdout_buffer, _IOFBF, BARO__STDOUT_BUF_SIZE);
+
+        if (context->capture_stderr) {
+            fflush(stderr);
+            if (context->real_stderr == -1) {
+                context->real_stderr = dup(fileno(stderr));
+            }
+            dup2(context->stdout_capture, fileno(stderr));
+        }
+#endif
     } else if (context->real_stdout != -1) {
+#ifdef _WIN32
         baro__disable_output(context, stdout);
-
+#else
+        fflush(stdout);
+        if (context->real_stderr != -1) {
+            fflush(stderr);
+            dup2(context->real_stderr, fileno(stderr));
+        }
+#endif
         dup2(context->real_stdout, fileno(stdout));
     }
 }
 
+// Forgets the output captured so far
+static inline void baro__clear_output(
+        struct baro__context * const context) {
+#ifdef _WIN32
+    if (context->stdout_buffer != NULL) {
+        memset(context->stdout_buffer, 0, context->stdout_tail_size + 1);
+    }
+#else
+    if (context->stdout_capture != -1) {
+        fflush(stdout);
+        if (ftruncate(context->stdout_capture, 0) != 0) {
+            fprintf(stderr, "Failed to clear captured stdout\n");
+        }
+        lseek(context->stdout_capture, 0, SEEK_SET);
+    }
+#endif
+}
+
+// Adds the tail of the output captured so far to a report, as is. Returns the
+// number of bytes added.
+static inline size_t baro__append_output(
+        struct baro__context * const context,
+        struct baro__report * const report) {
+#ifdef _WIN32
+    if (context->stdout_buffer == NULL) {
+        return 0;
+    }
+    size_t const size = strlen(context->stdout_buffer);
+    memcpy(baro__report_reserve(report, size), context->stdout_buffer, size);
+    report->size += size;
+    return size;
+#else
+    if (context->stdout_capture == -1) {
+        return 0;
+    }
+
+    fflush(stdout);
+    off_t const size = lseek(context->stdout_capture, 0, SEEK_END);
+    if (size <= 0) {
+        return 0;
+    }
+
+    size_t const tail_size = (size_t) size < context->stdout_tail_size
+                             ? (size_t) size : context->stdout_tail_size;
+    ssize_t const num_read = pread(context->stdout_capture, baro__report_reserve(report, tail_size),
+                                   tail_size, size - (off_t) tail_size);
+    if (num_read <= 0) {
+        return 0;
+    }
+    report->size += (size_t) num_read;
+    return (size_t) num_read;
+#endif
+}
+
+// Adds the tail of the output captured so far to the report, and forgets it
+static inline void baro__report_output(
+        struct baro__context * const context) {
+    size_t const size = context->report.size;
+    baro__report_printf(&context->report, "Captured output:\n");
+    if (baro__append_output(context, &context->report) > 0) {
+        baro__report_printf(&context->report, "\n");
+    } else {
+        context->report.size = size;
+    }
+
+    baro__clear_output(context);
+}
+
 static inline void baro__register_test(
         void (* const test_func)(void),
-        struct baro__tag const * const tag) {
-    if (baro__c.tests.size == 0) {
-        baro__context_create(&baro__c);
+        struct baro__tag const * const tag,
+        int const bench) {
+    if (baro__tests.capacity == 0) {
+        baro__test_list_create(&baro__tests, 128);
     }
 
-    struct baro__test const test = {.func = test_func, .tag = tag};
-    baro__test_list_add(&baro__c.tests, &test);
+    struct baro__test const test = {.func = test_func, .tag = tag, .bench = bench};
+    baro__test_list_add(&baro__tests, &test);
+}
+
+static inline size_t baro__bench_start(void) {
+    baro__c.bench_looped = 1;
+    baro__bench_count(0);
+    baro__c.bench_start_ns = baro__now_ns();
+    return baro__c.bench_iterations;
+}
+
+static inline int baro__bench_stop(void) {
+    baro__c.bench_elapsed_ns += baro__now_ns() - baro__c.bench_start_ns;
+    baro__bench_count(1);
+    return 0;
 }
 
 static inline int baro__check_subtest(
         struct baro__tag const * const tag) {
-    if (baro__tag_list_size(&baro__c.subtest_stack) < baro__c.subtest_max_size) {
-        baro__c.should_reenter_subtest = 1;
+    size_t const depth = baro__tag_list_size(&baro__c.subtest_stack);
+    if (depth < baro__c.subtest_filter_size && strcmp(tag->desc, baro__c.subtest_filter[depth]) != 0) {
         return 0;
     }
 
-    baro__tag_list_push(&baro__c.subtest_stack, tag);
-    if (baro__hash_set_contains(&baro__c.passed_subtests,
-                                baro__tag_list_hash(&baro__c.subtest_stack))) {
-        baro__tag_list_pop(&baro__c.subtest_stack, NULL);
+    struct baro__subtest_trie * const trie = &baro__c.subtests;
+    size_t node = baro__subtest_trie_find(trie, baro__c.subtest_node, tag);
+
+    if (depth < baro__c.subtest_path_size) {
+        // On the way down a scheduled path, its siblings belong to other passes
+        if (tag != baro__c.subtest_path[depth] || node != 0) {
+            return 0;
+        }
+    } else if (depth < baro__c.subtest_max_size) {
+        // This is a sibling of a subtest that already ran in this pass, so it
+        // has to wait for another pass, unless there is nothing left to run
+        if (node == 0 || !trie->nodes[node].done) {
+            if (baro__c.split_subtests) {
+                // The other pass runs it, so it is done as far as this one goes
+                if (node == 0) {
+                    node = baro__subtest_trie_add(trie, baro__c.subtest_node, tag);
+                }
+                trie->nodes[node].done = 1;
+                baro__split_subtest(tag);
+            } else {
+                baro__c.should_reenter_subtest = 1;
+            }
+        }
         return 0;
     }
 
+    if (node != 0 && trie->nodes[node].done) {
+        return 0;
+    }
+    if (baro__c.fork_subtests && !baro__fork_subtest(tag)) {
+        // Another process has already run the subtest, starting from here
+        return 0;
+    }
+    if (node == 0) {
+        node = baro__subtest_trie_add(trie, baro__c.subtest_node, tag);
+    }
+
+    baro__tag_list_push(&baro__c.subtest_stack, tag);
+    baro__c.subtest_node = node;
     baro__c.subtest_max_size = baro__c.subtest_stack.size;
     baro__c.subtest_entered = 1;
+
+    // Each subtest entered in a pass is nested in the previous one, so the
+    // last one entered is the leaf
+    baro__c.leaf = tag;
+    baro__c.leaf_start_ns = baro__now_ns();
+    baro__c.leaf_end_ns = 0;
     return 1;
 }
 
 static inline void baro__exit_subtest(void) {
     if (baro__c.subtest_entered) {
+        struct baro__subtest_node * const node = &baro__c.subtests.nodes[baro__c.subtest_node];
         if (!baro__c.should_reenter_subtest) {
-            baro__hash_set_add(&baro__c.passed_subtests, baro__tag_list_hash(&baro__c.subtest_stack));
+            node->done = 1;
+        }
+
+        if (baro__c.subtest_stack.size == baro__c.subtest_max_size) {
+            baro__c.leaf_end_ns = baro__now_ns();
         }
 
         baro__tag_list_pop(&baro__c.subtest_stack, NULL);
+        baro__c.subtest_node = node->parent;
+
+        // A process forked to run a subtest has nothing left to do after it
+        if (baro__c.subtest_stack.size + 1 == baro__c.fork_depth) {
+            baro__end_subtest_fork(0);
+        }
     }
 }
 
@@ -432,6 +1018,7 @@ enum baro__expected_value {
 enum baro__jmp_val {
     BARO__JMP_REQUIRE = 1,
     BARO__JMP_SIGABRT,
+    BARO__JMP_TIMEOUT,
 };
 
 static char const *extract_file_name(
@@ -446,26 +1033,23 @@ static char const *extract_file_name(
 }
 
 static inline void baro__assert_failed(
-        enum baro__assert_type const type, int const jump) {
+        struct baro__report * const out,
+        enum baro__assert_type const type,
+        int const jump) {
     struct baro__test const * const test = baro__c.current_test;
-    printf("  In: %s (%s:%d)\n",
-           test->tag->desc, extract_file_name(test->tag->file_path), test->tag->line_num);
+    baro__report_printf(out, "  In: %s (%s:%d)\n",
+                        test->tag->desc, extract_file_name(test->tag->file_path), test->tag->line_num);
 
     for (size_t i = 0; i < baro__c.subtest_stack.size; i++) {
         struct baro__tag const * const subtest_tag = baro__c.subtest_stack.tags[i];
-        printf("%*cUnder: %s (%s:%d)\n", (int) (i + 2) * 2, ' ',
-               subtest_tag->desc, extract_file_name(subtest_tag->file_path), subtest_tag->line_num);
+        baro__report_printf(out, "%*cUnder: %s (%s:%d)\n", (int) (i + 2) * 2, ' ',
+                            subtest_tag->desc, extract_file_name(subtest_tag->file_path),
+                            subtest_tag->line_num);
     }
 
-    if (baro__c.stdout_buffer[0]) {
-        printf("Captured output:\n%s\n", baro__c.stdout_buffer);
-
-        memset(baro__c.stdout_buffer, 0, BARO__STDOUT_BUF_SIZE);
-    }
+    baro__report_output(&baro__c);
 
-    printf(BARO__SEPARATOR);
-
-    baro__redirect_output(&baro__c, 1);
+    baro__report_printf(out, BARO__SEPARATOR);
 
     if (type == BARO__ASSERT_REQUIRE && jump) {
         longjmp(baro__c.env, BARO__JMP_REQUIRE);
@@ -489,43 +1073,97 @@ static inline void baro__assert1(
     baro__c.current_test_failed = 1;
     baro__c.num_asserts_failed++;
 
-    baro__redirect_output(&baro__c, 0);
+    struct baro__report * const out = &baro__c.report;
 
     char const * const assert_type = (type == BARO__ASSERT_REQUIRE ? "Require" : "Check");
     char const * const op = (expected_value == BARO__EXPECTING_TRUE ? " != 0" : " == 0");
-    printf(BARO__RED "%s failed:%s\n" BARO__UNSET_COLOR, assert_type, desc);
-    printf("    %s%s\n", value_str, op);
-    printf("==> %zu%s\n", value, op);
-    printf("At %s:%d\n", extract_file_name(file_path), line_num);
+    baro__report_printf(out, BARO__RED "%s failed:%s\n" BARO__UNSET_COLOR, assert_type, desc);
+    baro__report_printf(out, "    %s%s\n", value_str, op);
+    baro__report_printf(out, "==> %zu%s\n", value, op);
+    baro__report_printf(out, "At %s:%d\n", extract_file_name(file_path), line_num);
 
-    baro__assert_failed(type, 1);
+    baro__assert_failed(out, type, 1);
 }
 
-static inline void baro__assert2(
-        enum baro__assert_cond cond,
-        size_t lhs,
-        char const *lhs_str,
-        size_t rhs,
-        char const *rhs_str,
-        enum baro__assert_type type,
-        char const *desc,
-        char const *file_path,
-        int line_num) {
-    baro__c.num_asserts++;
+// Two-sided assertions are checked inline, with the values as C would compare
+// them. Formatting a failure is kept out of line, out of the way of the code
+// under test, as most assertions in a loop never fail.
+#if defined(__GNUC__) || defined(__clang__)
+#define BARO__FORCE_INLINE inline __attribute__((always_inline))
+#define BARO__COLD __attribute__((noinline, cold, unused))
+#define BARO__UNLIKELY(x) __builtin_expect(!!(x), 0)
+#elif defined(_MSC_VER)
+#define BARO__FORCE_INLINE __forceinline
+#define BARO__COLD __declspec(noinline)
+#define BARO__UNLIKELY(x) (x)
+#else
+#define BARO__FORCE_INLINE inline
+#define BARO__COLD
+#define BARO__UNLIKELY(x) (x)
+#endif
 
-    if ((cond == BARO__ASSERT_EQ && lhs == rhs) ||
-        (cond == BARO__ASSERT_NE && lhs != rhs) ||
-        (cond == BARO__ASSERT_LT && lhs < rhs) ||
-        (cond == BARO__ASSERT_LE && lhs <= rhs) ||
-        (cond == BARO__ASSERT_GT && lhs > rhs) ||
-        (cond == BARO__ASSERT_GE && lhs >= rhs)) {
-        return;
+// How the two sides of an assertion were compared, and so how to show them
+enum baro__value_kind {
+    BARO__VALUE_SIGNED,
+    BARO__VALUE_UNSIGNED,
+    BARO__VALUE_DOUBLE,
+    BARO__VALUE_LONG_DOUBLE,
+    BARO__VALUE_POINTER,
+};
+
+union baro__value {
+    long long i;
+    unsigned long long u;
+    double d;
+    long double ld;
+    void const *p;
+};
+
+// The condition is a constant at every call site, so this folds away
+#define BARO__COMPARE(cond, lhs, rhs)               \
+    ((cond) == BARO__ASSERT_EQ ? (lhs) == (rhs) :   \
+     (cond) == BARO__ASSERT_NE ? (lhs) != (rhs) :   \
+     (cond) == BARO__ASSERT_LT ? (lhs) < (rhs) :    \
+     (cond) == BARO__ASSERT_LE ? (lhs) <= (rhs) :   \
+     (cond) == BARO__ASSERT_GT ? (lhs) > (rhs) : (lhs) >= (rhs))
+
+// Writes a floating-point value with as few digits as tell it apart from
+// every other value of its type
+static inline void baro__format_floating(
+        char * const buffer,
+        size_t const size,
+        enum baro__value_kind const kind,
+        union baro__value const * const value) {
+    for (int precision = 1; precision <= 40; precision++) {
+        if (kind == BARO__VALUE_DOUBLE) {
+            snprintf(buffer, size, "%.*g", precision, value->d);
+            if (strtod(buffer, NULL) == value->d) {
+                return;
+            }
+        } else {
+            snprintf(buffer, size, "%.*Lg", precision, value->ld);
+            if (strtold(buffer, NULL) == value->ld) {
+                return;
+            }
+        }
     }
+}
 
+static BARO__COLD void baro__assert2_failed(
+        enum baro__assert_cond const cond,
+        enum baro__value_kind const kind,
+        union baro__value const * const lhs,
+        char const * const lhs_str,
+        union baro__value const * const rhs,
+        char const * const rhs_str,
+        enum baro__assert_type const type,
+        char const * const desc,
+        char const * const file_path,
+        int const line_num) {
     baro__c.current_test_failed = 1;
     baro__c.num_asserts_failed++;
 
-    baro__redirect_output(&baro__c, 0);
+    struct baro__report * const out = &baro__c.report;
 
     char const * const op =
             cond == BARO__ASSERT_EQ ? "==" :
@@ -535,15 +1173,89 @@ static inline void baro__assert2(
             cond == BARO__ASSERT_GT ? ">" :
             cond == BARO__ASSERT_GE ? ">=" : "";
 
+    // NaNs, infinities and the longest pointers all fit
+    char lhs_val_str[64], rhs_val_str[64];
+    switch (kind) {
+    case BARO__VALUE_SIGNED:
+        snprintf(lhs_val_str, sizeof(lhs_val_str), "%lld", lhs->i);
+        snprintf(rhs_val_str, sizeof(rhs_val_str), "%lld", rhs->i);
+        break;
+    case BARO__VALUE_UNSIGNED:
+        snprintf(lhs_val_str, sizeof(lhs_val_str), "%llu", lhs->u);
+        snprintf(rhs_val_str, sizeof(rhs_val_str), "%llu", rhs->u);
+        break;
+    case BARO__VALUE_DOUBLE:
+    case BARO__VALUE_LONG_DOUBLE:
+        baro__format_floating(lhs_val_str, sizeof(lhs_val_str), kind, lhs);
+        baro__format_floating(rhs_val_str, sizeof(rhs_val_str), kind, rhs);
+        break;
+    case BARO__VALUE_POINTER:
+        snprintf(lhs_val_str, sizeof(lhs_val_str), "%p", lhs->p);
+        snprintf(rhs_val_str, sizeof(rhs_val_str), "%p", rhs->p);
+        break;
+    }
+
     char const * const assert_type = (type == BARO__ASSERT_REQUIRE ? "Require" : "Check");
-    printf(BARO__RED "%s failed:%s\n" BARO__UNSET_COLOR, assert_type, desc);
-    printf("    %s %s %s\n", lhs_str, op, rhs_str);
-    printf("==> %zu %s %zu\n", lhs, op, rhs);
-    printf("At %s:%d\n", extract_file_name(file_path), line_num);
+    baro__report_printf(out, BARO__RED "%s failed:%s\n" BARO__UNSET_COLOR, assert_type, desc);
+    baro__report_printf(out, "    %s %s %s\n", lhs_str, op, rhs_str);
+    baro__report_printf(out, "==> %s %s %s\n", lhs_val_str, op, rhs_val_str);
+    baro__report_printf(out, "At %s:%d\n", extract_file_name(file_path), line_num);
 
-    baro__assert_failed(type, 1);
+    baro__assert_failed(out, type, 1);
 }
 
+// Defines the inline check for one kind of value, which hands the values over
+// to baro__assert2_failed() only once the comparison has failed
+#define BARO__DEFINE_ASSERT2(name, param_type, kind, member, compare_type)                      \
+    static BARO__FORCE_INLINE void name(                                                       \
+            enum baro__assert_cond const cond,                                                 \
+            param_type const lhs,                                                              \
+            char const * const lhs_str,                                                        \
+            param_type const rhs,                                                              \
+            char const * const rhs_str,                                                        \
+            enum baro__assert_type const type,                                                 \
+            char const * const desc,                                                           \
+            char const * const file_path,                                                      \
+            int const line_num) {                                                              \
+        baro__c.num_asserts++;                                                                 \
+        if (BARO__UNLIKELY(!BARO__COMPARE(cond, (compare_type) lhs, (compare_type) rhs))) {     \
+            union baro__value lhs_val, rhs_val;                                                \
+            lhs_val.member = lhs;                                                              \
+            rhs_val.member = rhs;                                                              \
+            baro__assert2_failed(cond, kind, &lhs_val, lhs_str, &rhs_val, rhs_str, type, desc, \
+                                 file_path, line_num);                                         \
+        }                                                                                      \
+    }
+
+BARO__DEFINE_ASSERT2(baro__assert2_signed, long long, BARO__VALUE_SIGNED, i, long long)
+BARO__DEFINE_ASSERT2(baro__assert2_unsigned, unsigned long long, BARO__VALUE_UNSIGNED, u, unsigned long long)
+BARO__DEFINE_ASSERT2(baro__assert2_double, double, BARO__VALUE_DOUBLE, d, double)
+BARO__DEFINE_ASSERT2(baro__assert2_long_double, long double, BARO__VALUE_LONG_DOUBLE, ld, long double)
+BARO__DEFINE_ASSERT2(baro__assert2_pointer, void const *, BARO__VALUE_POINTER, p, uintptr_t)
+
+// Picks the check by the type that C compares both sides as, after the usual
+// arithmetic conversions, which a conditional expression applies without
+// evaluating either side. Anything else is a pointer. Without _Generic, in
+// C++ or before C11, both sides are compared as size_t.
+#if !defined(__cplusplus) && \
+    ((defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L) || defined(__clang__) || __GNUC__ >= 5)
+#define baro__assert2(cond, lhs, lhs_str, rhs, rhs_str, type, desc, file_path, line_num) \
+    _Generic(1 ? (lhs) : (rhs),                                                         \
+        int: baro__assert2_signed,                                                      \
+        long: baro__assert2_signed,                                                     \
+        long long: baro__assert2_signed,                                                \
+        unsigned: baro__assert2_unsigned,                                               \
+        unsigned long: baro__assert2_unsigned,                                          \
+        unsigned long long: baro__assert2_unsigned,                                     \
+        float: baro__assert2_double,                                                    \
+        double: baro__assert2_double,                                                   \
+        long double: baro__assert2_long_double,                                         \
+        default: baro__assert2_pointer)(cond, lhs, lhs_str, rhs, rhs_str, type, desc, file_path, line_num)
+#else
+#define baro__assert2(cond, lhs, lhs_str, rhs, rhs_str, type, desc, file_path, line_num) \
+    baro__assert2_unsigned(cond, (size_t) (lhs), lhs_str, (size_t) (rhs), rhs_str, type, desc, file_path, line_num)
+#endif
+
 static inline void baro__assert_str(
         char const *lhs,
         char const *lhs_str,
@@ -565,7 +1277,7 @@ static inline void baro__assert_str(
     baro__c.current_test_failed = 1;
     baro__c.num_asserts_failed++;
 
-    baro__redirect_output(&baro__c, 0);
+    struct baro__report * const out = &baro__c.report;
 
     char const * const op = (expected_value == BARO__EXPECTING_TRUE ? "==" : "!=");
     char const * const assert_type = (type == BARO__ASSERT_REQUIRE ? "Require" : "Check");
@@ -591,12 +1303,12 @@ static inline void baro__assert_str(
         str_padding = expanded_len - str_len;
     }
 
-    printf(BARO__RED "%s%s failed:%s\n" BARO__UNSET_COLOR, assert_type, sensitivity, desc);
-    printf("    %s %*s%s %s\n", lhs_str, (int)str_padding, "", op, rhs_str);
-    printf("==> %s%s%s %*s%s %s%s%s\n", lhs_wrap, lhs, lhs_wrap, (int)expanded_padding, "", op, rhs_wrap, rhs, rhs_wrap);
-    printf("At %s:%d\n", extract_file_name(file_path), line_num);
+    baro__report_printf(out, BARO__RED "%s%s failed:%s\n" BARO__UNSET_COLOR, assert_type, sensitivity, desc);
+    baro__report_printf(out, "    %s %*s%s %s\n", lhs_str, (int)str_padding, "", op, rhs_str);
+    baro__report_printf(out, "==> %s%s%s %*s%s %s%s%s\n", lhs_wrap, lhs, lhs_wrap, (int)expanded_padding, "", op, rhs_wrap, rhs, rhs_wrap);
+    baro__report_printf(out, "At %s:%d\n", extract_file_name(file_path), line_num);
 
-    baro__assert_failed(type, 1);
+    baro__assert_failed(out, type, 1);
 }
 
 static inline void baro__assert_arr(
@@ -631,7 +1343,7 @@ static inline void baro__assert_arr(
     baro__c.current_test_failed = 1;
     baro__c.num_asserts_failed++;
 
-    baro__redirect_output(&baro__c, 0);
+    struct baro__report * const out = &baro__c.report;
 
     char const * const op = (expected_value == BARO__EXPECTING_TRUE ? "==" : "!=");
     char const * const assert_type = (type == BARO__ASSERT_REQUIRE ? "Require" : "Check");
@@ -659,15 +1371,90 @@ static inline void baro__assert_arr(
     *p = '\0';
     *q = '\0';
 
-    printf(BARO__RED "%s array failed:%s\n" BARO__UNSET_COLOR, assert_type, desc);
-    printf("    %s[%zu] %s %s[%zu]\n", lhs_str, element_index, op, rhs_str, element_index);
-    printf("==> 0x%s %s 0x%s\n", lhs_val_str, op, rhs_val_str);
-    printf("At %s:%d\n", extract_file_name(file_path), line_num);
+    baro__report_printf(out, BARO__RED "%s array failed:%s\n" BARO__UNSET_COLOR, assert_type, desc);
+    baro__report_printf(out, "    %s[%zu] %s %s[%zu]\n", lhs_str, element_index, op, rhs_str, element_index);
+    baro__report_printf(out, "==> 0x%s %s 0x%s\n", lhs_val_str, op, rhs_val_str);
+    baro__report_printf(out, "At %s:%d\n", extract_file_name(file_path), line_num);
 
     free(lhs_val_str);
     free(rhs_val_str);
 
-    baro__assert_failed(type, 1);
+    baro__assert_failed(out, type, 1);
+}
+
+// Reads one hardware counter, or UINT64_MAX when it can't be read
+static inline uint64_t baro__read_counter(
+        enum baro__counter const counter) {
+    uint64_t values[BARO__NUM_COUNTERS];
+    return baro__read_counters(values) & (1u << counter) ? values[counter] : UINT64_MAX;
+}
+
+// Checks what a block of code counted against a budget, from counts read
+// before and after it. Budgets can't be checked without a count, which reads
+// as UINT64_MAX, so they are skipped rather than failed.
+static inline void baro__assert_max_count(
+        uint64_t const start,
+        uint64_t const end,
+        char const * const name,
+        uint64_t const max,
+        char const * const max_str,
+        enum baro__assert_type const type,
+        char const * const file_path,
+        int const line_num) {
+    if (start == UINT64_MAX || end == UINT64_MAX) {
+        return;
+    }
+
+    baro__c.num_asserts++;
+
+    uint64_t const count = end - start;
+    if (count <= max) {
+        return;
+    }
+
+    baro__c.current_test_failed = 1;
+    baro__c.num_asserts_failed++;
+
+    struct baro__report * const out = &baro__c.report;
+
+    char const * const assert_type = (type == BARO__ASSERT_REQUIRE ? "Require" : "Check");
+    baro__report_printf(out, BARO__RED "%s failed: too many %s\n" BARO__UNSET_COLOR, assert_type, name);
+    baro__report_printf(out, "    %s <= %s\n", name, max_str);
+    baro__report_printf(out, "==> %llu > %llu\n", (unsigned long long) count, (unsigned long long) max);
+    baro__report_printf(out, "At %s:%d\n", extract_file_name(file_path), line_num);
+
+    baro__assert_failed(out, type, 1);
+}
+
+// Checks how long a block of code took, since `start_ns`, against a budget in
+// milliseconds
+static inline void baro__assert_within_ms(
+        uint64_t const start_ns,
+        double const max_ms,
+        char const * const max_str,
+        enum baro__assert_type const type,
+        char const * const file_path,
+        int const line_num) {
+    double const ms = (double) (baro__now_ns() - start_ns) / 1e6;
+
+    baro__c.num_asserts++;
+
+    if (ms <= max_ms) {
+        return;
+    }
+
+    baro__c.current_test_failed = 1;
+    baro__c.num_asserts_failed++;
+
+    struct baro__report * const out = &baro__c.report;
+
+    char const * const assert_type = (type == BARO__ASSERT_REQUIRE ? "Require" : "Check");
+    baro__report_printf(out, BARO__RED "%s failed: took too long\n" BARO__UNSET_COLOR, assert_type);
+    baro__report_printf(out, "    elapsed <= %s ms\n", max_str);
+    baro__report_printf(out, "==> %.3f ms > %g ms\n", ms, max_ms);
+    baro__report_printf(out, "At %s:%d\n", extract_file_name(file_path), line_num);
+
+    baro__assert_failed(out, type, 1);
 }
 
 // Turn the regular assert.h assert() into a baro assertion. This is a
@@ -715,26 +1502,127 @@ do { (void)(lhs); (void)(rhs); (void)(element_size); (void)(element_count); (voi
     __attribute__((constructor)) static void f(void)
 #endif//_MSC_VER
 
+#if defined(__ELF__) && !defined(BARO_NO_TEST_SECTION)
+// On ELF platforms, every test is emitted straight into a section of its own,
+// which the linker gathers into one array across all compilation units and
+// brackets with `__start_baro_tests` and `__stop_baro_tests`. The runner walks
+// that array in place, so startup takes no allocations or constructor calls.
+// The entries are writable so that the runner can sort them where they are,
+// and their alignment is pinned so that the compiler can't pad between them.
+#define BARO__TEST_SECTION
+#define BARO__CREATE_TEST_REGISTRAR(func_name, desc, is_bench)                  \
+    static struct baro__tag const func_name##_tag = {desc, __FILE__, __LINE__}; \
+    static struct baro__test func_name##_entry                                  \
+        __attribute__((used, section("baro_tests"), aligned(sizeof(void *)))) = \
+        {.tag = &func_name##_tag, .func = func_name, .bench = is_bench};
+#else
 // All test functions are registered by a "registrar function" sometime during
 // runtime initialization. This is used to automatically build a list of all
 // tests, across compilation units, for the test runner.
-#define BARO__CREATE_TEST_REGISTRAR(func_name, desc)                            \
+#define BARO__CREATE_TEST_REGISTRAR(func_name, desc, is_bench)                  \
     static struct baro__tag const func_name##_tag = {desc, __FILE__, __LINE__}; \
     BARO__INITIALIZER(func_name##_registrar) {                                  \
-        baro__register_test(func_name, &func_name##_tag);                       \
+        baro__register_test(func_name, &func_name##_tag, is_bench);             \
     }
+#endif//defined(__ELF__) && !defined(BARO_NO_TEST_SECTION)
 
 #ifdef BARO_ENABLE
-#define BARO__TEST_FUNC(func_name, desc)         \
-    static void func_name(void);                 \
-    BARO__CREATE_TEST_REGISTRAR(func_name, desc) \
+#define BARO__TEST_FUNC(func_name, desc, is_bench)         \
+    static void func_name(void);                           \
+    BARO__CREATE_TEST_REGISTRAR(func_name, desc, is_bench) \
     static void func_name(void)
 #else
 #define BARO__TEST_FUNC(func_name, ...) \
     static void __attribute__((unused)) func_name(void)
 #endif//BARO_ENABLE
 
-#define BARO_TEST(desc) BARO__TEST_FUNC(BARO__WITH_COUNTER(BARO_TEST_), desc)
+#define BARO_TEST(desc) BARO__TEST_FUNC(BARO__WITH_COUNTER(BARO_TEST_), desc, 0)
+
+// A benchmark is registered like a test, but only runs with --bench. The
+// runner calls it over and over, and times either its BENCH_LOOP or, without
+// one, the whole call. Benchmarks can't have subtests.
+#define BARO_BENCH(desc) BARO__TEST_FUNC(BARO__WITH_COUNTER(BARO_BENCH_), desc, 1)
+
+// Runs the code that follows as many times as the runner asks for, and times
+// it, leaving any setup before the loop out of the measurement
+#ifdef BARO_ENABLE
+#define BARO__BENCH_LOOP(counter)                                                   \
+    for (size_t BARO__CONCAT(baro__bench_i_, counter) = baro__bench_start();        \
+         BARO__CONCAT(baro__bench_i_, counter)-- > 0 || baro__bench_stop();)
+#else
+#define BARO__BENCH_LOOP(counter) for (;0;)
+#endif//BARO_ENABLE
+#define BARO_BENCH_LOOP BARO__BENCH_LOOP(__COUNTER__)
+
+// Runs the code that follows once, and fails when what `read` counts went up by
+// more than `max` while it ran
+#ifdef BARO_ENABLE
+#define BARO__MAX_COUNT(read, name, max, type, counter)                                                 \
+    for (uint64_t BARO__CONCAT(baro__count_start_, counter) = (read),                                  \
+                  BARO__CONCAT(baro__count_once_, counter) = 1;                                        \
+         BARO__CONCAT(baro__count_once_, counter);                                                     \
+         BARO__CONCAT(baro__count_once_, counter) = 0,                                                 \
+         baro__assert_max_count(BARO__CONCAT(baro__count_start_, counter), (read), name,               \
+                                (uint64_t) (max), #max, type, __FILE__, __LINE__))
+#else
+#define BARO__MAX_COUNT(read, name, max, type, counter) \
+    for (int BARO__CONCAT(baro__count_once_, counter) = ((void) (max), 1); BARO__CONCAT(baro__count_once_, counter); \
+         BARO__CONCAT(baro__count_once_, counter) = 0)
+#endif//BARO_ENABLE
+
+// Fails when the block that follows took more than `max` instructions,
+// counting only those in user space. This is skipped where hardware counters
+// aren't available.
+#define BARO_CHECK_MAX_INSTRUCTIONS(max) \
+    BARO__MAX_COUNT(baro__read_counter(BARO__COUNTER_INSTRUCTIONS), "instructions", max, BARO__ASSERT_CHECK, __COUNTER__)
+#define BARO_REQUIRE_MAX_INSTRUCTIONS(max) \
+    BARO__MAX_COUNT(baro__read_counter(BARO__COUNTER_INSTRUCTIONS), "instructions", max, BARO__ASSERT_REQUIRE, __COUNTER__)
+
+// Fails when the block that follows made more than `max` allocations, counting
+// calls to malloc, calloc and realloc. This is skipped unless the runner is
+// built with BARO_TRACK_ALLOCS.
+#define BARO_CHECK_MAX_ALLOCS(max) \
+    BARO__MAX_COUNT(baro__num_allocs(), "allocations", max, BARO__ASSERT_CHECK, __COUNTER__)
+#define BARO_REQUIRE_MAX_ALLOCS(max) \
+    BARO__MAX_COUNT(baro__num_allocs(), "allocations", max, BARO__ASSERT_REQUIRE, __COUNTER__)
+#define BARO_CHECK_NO_ALLOCS BARO_CHECK_MAX_ALLOCS(0)
+#define BARO_REQUIRE_NO_ALLOCS BARO_REQUIRE_MAX_ALLOCS(0)
+
+// Fails when the block that follows took more than `ms` milliseconds of wall
+// time. The block runs to the end either way; --timeout is what stops a test
+// that hangs.
+#ifdef BARO_ENABLE
+#define BARO__WITHIN_MS(ms, type, counter)                                                                \
+    for (uint64_t BARO__CONCAT(baro__within_start_, counter) = baro__now_ns(),                           \
+                  BARO__CONCAT(baro__within_once_, counter) = 1;                                         \
+         BARO__CONCAT(baro__within_once_, counter);                                                      \
+         BARO__CONCAT(baro__within_once_, counter) = 0,                                                  \
+         baro__assert_within_ms(BARO__CONCAT(baro__within_start_, counter), (double) (ms), #ms, type,    \
+                                __FILE__, __LINE__))
+#else
+#define BARO__WITHIN_MS(ms, type, counter) \
+    for (int BARO__CONCAT(baro__within_once_, counter) = ((void) (ms), 1); BARO__CONCAT(baro__within_once_, counter); \
+         BARO__CONCAT(baro__within_once_, counter) = 0)
+#endif//BARO_ENABLE
+#define BARO_CHECK_WITHIN_MS(ms) BARO__WITHIN_MS(ms, BARO__ASSERT_CHECK, __COUNTER__)
+#define BARO_REQUIRE_WITHIN_MS(ms) BARO__WITHIN_MS(ms, BARO__ASSERT_REQUIRE, __COUNTER__)
+
+// Keeps the compiler from optimizing away the computation of a value, or from
+// keeping memory in registers across the barrier. Outside of GCC and Clang,
+// the value has to be an lvalue.
+#if defined(__GNUC__) || defined(__clang__)
+#define BARO_DO_NOT_OPTIMIZE(value) __asm__ __volatile__("" : : "r,m"(value) : "memory")
+#define BARO_CLOBBER_MEMORY() __asm__ __volatile__("" : : : "memory")
+#elif defined(_MSC_VER)
+#include <intrin.h>
+static void const * volatile baro__bench_sink;
+#define BARO_DO_NOT_OPTIMIZE(value) (baro__bench_sink = (void const *) &(value), _ReadWriteBarrier())
+#define BARO_CLOBBER_MEMORY() _ReadWriteBarrier()
+#else
+static void const * volatile baro__bench_sink;
+#define BARO_DO_NOT_OPTIMIZE(value) (baro__bench_sink = (void const *) &(value))
+#define BARO_CLOBBER_MEMORY() (baro__bench_sink = &baro__bench_sink)
+#endif
 
 #ifdef BARO_ENABLE
 // Here we abuse a while loop so that our macro can call functions before and
@@ -773,41 +1661,41 @@ do { (void)(lhs); (void)(rhs); (void)(element_size); (void)(element_count); (voi
 #define BARO__REQUIRE_FALSE1(cond) baro__assert1((size_t)cond, #cond, BARO__EXPECTING_FALSE, BARO__ASSERT_REQUIRE, "", __FILE__, __LINE__)
 #define BARO__REQUIRE_FALSE2(cond, desc) baro__assert1((size_t)cond, #cond, BARO__EXPECTING_FALSE, BARO__ASSERT_REQUIRE, " " desc, __FILE__, __LINE__)
 
-#define BARO__CHECK_EQ1(lhs, rhs) baro__assert2(BARO__ASSERT_EQ, (size_t)lhs, #lhs, (size_t)rhs, #rhs, 0, "", __FILE__, __LINE__)
-#define BARO__CHECK_EQ2(lhs, rhs, desc) baro__assert2(BARO__ASSERT_EQ, (size_t)lhs, #lhs, (size_t)rhs, #rhs, 0, " " desc, __FILE__, __LINE__)
+#define BARO__CHECK_EQ1(lhs, rhs) baro__assert2(BARO__ASSERT_EQ, (lhs), #lhs, (rhs), #rhs, 0, "", __FILE__, __LINE__)
+#define BARO__CHECK_EQ2(lhs, rhs, desc) baro__assert2(BARO__ASSERT_EQ, (lhs), #lhs, (rhs), #rhs, 0, " " desc, __FILE__, __LINE__)
 
-#define BARO__REQUIRE_EQ1(lhs, rhs) baro__assert2(BARO__ASSERT_EQ, (size_t)lhs, #lhs, (size_t)rhs, #rhs, BARO__ASSERT_REQUIRE, "", __FILE__, __LINE__)
-#define BARO__REQUIRE_EQ2(lhs, rhs, desc) baro__assert2(BARO__ASSERT_EQ, (size_t)lhs, #lhs, (size_t)rhs, #rhs, BARO__ASSERT_REQUIRE, " " desc, __FILE__, __LINE__)
+#define BARO__REQUIRE_EQ1(lhs, rhs) baro__assert2(BARO__ASSERT_EQ, (lhs), #lhs, (rhs), #rhs, BARO__ASSERT_REQUIRE, "", __FILE__, __LINE__)
+#define BARO__REQUIRE_EQ2(lhs, rhs, desc) baro__assert2(BARO__ASSERT_EQ, (lhs), #lhs, (rhs), #rhs, BARO__ASSERT_REQUIRE, " " desc, __FILE__, __LINE__)
 
-#define BARO__CHECK_NE1(lhs, rhs) baro__assert2(BARO__ASSERT_NE, (size_t)lhs, #lhs, rhs, #rhs, 0, "", __FILE__, __LINE__)
-#define BARO__CHECK_NE2(lhs, rhs, desc) baro__assert2(BARO__ASSERT_NE, (size_t)lhs, #lhs, rhs, #rhs, 0, " " desc, __FILE__, __LINE__)
+#define BARO__CHECK_NE1(lhs, rhs) baro__assert2(BARO__ASSERT_NE, (lhs), #lhs, (rhs), #rhs, 0, "", __FILE__, __LINE__)
+#define BARO__CHECK_NE2(lhs, rhs, desc) baro__assert2(BARO__ASSERT_NE, (lhs), #lhs, (rhs), #rhs, 0, " " desc, __FILE__, __LINE__)
 
-#define BARO__REQUIRE_NE1(lhs, rhs) baro__assert2(BARO__ASSERT_NE, (size_t)lhs, #lhs, (size_t)rhs, #rhs, BARO__ASSERT_REQUIRE, "", __FILE__, __LINE__)
-#define BARO__REQUIRE_NE2(lhs, rhs, desc) baro__assert2(BARO__ASSERT_NE, (size_t)lhs, #lhs, (size_t)rhs, #rhs, BARO__ASSERT_REQUIRE, " " desc, __FILE__, __LINE__)
+#define BARO__REQUIRE_NE1(lhs, rhs) baro__assert2(BARO__ASSERT_NE, (lhs), #lhs, (rhs), #rhs, BARO__ASSERT_REQUIRE, "", __FILE__, __LINE__)
+#define BARO__REQUIRE_NE2(lhs, rhs, desc) baro__assert2(BARO__ASSERT_NE, (lhs), #lhs, (rhs), #rhs, BARO__ASSERT_REQUIRE, " " desc, __FILE__, __LINE__)
 
-#define BARO__CHECK_LT1(lhs, rhs) baro__assert2(BARO__ASSERT_LT, (size_t)lhs, #lhs, (size_t)rhs, #rhs, 0, "", __FILE__, __LINE__)
-#define BARO__CHECK_LT2(lhs, rhs, desc) baro__assert2(BARO__ASSERT_LT, (size_t)lhs, #lhs, (size_t)rhs, #rhs, 0, " " desc, __FILE__, __LINE__)
+#define BARO__CHECK_LT1(lhs, rhs) baro__assert2(BARO__ASSERT_LT, (lhs), #lhs, (rhs), #rhs, 0, "", __FILE__, __LINE__)
+#define BARO__CHECK_LT2(lhs, rhs, desc) baro__assert2(BARO__ASSERT_LT, (lhs), #lhs, (rhs), #rhs, 0, " " desc, __FILE__, __LINE__)
 
-#define BARO__REQUIRE_LT1(lhs, rhs) baro__assert2(BARO__ASSERT_LT, (size_t)lhs, #lhs, (size_t)rhs, #rhs, BARO__ASSERT_REQUIRE, "", __FILE__, __LINE__)
-#define BARO__REQUIRE_LT2(lhs, rhs, desc) baro__assert2(BARO__ASSERT_LT, (size_t)lhs, #lhs, (size_t)rhs, #rhs, BARO__ASSERT_REQUIRE, " " desc, __FILE__, __LINE__)
+#define BARO__REQUIRE_LT1(lhs, rhs) baro__assert2(BARO__ASSERT_LT, (lhs), #lhs, (rhs), #rhs, BARO__ASSERT_REQUIRE, "", __FILE__, __LINE__)
+#define BARO__REQUIRE_LT2(lhs, rhs, desc) baro__assert2(BARO__ASSERT_LT, (lhs), #lhs, (rhs), #rhs, BARO__ASSERT_REQUIRE, " " desc, __FILE__, __LINE__)
 
-#define BARO__CHECK_LE1(lhs, rhs) baro__assert2(BARO__ASSERT_LE, (size_t)lhs, #lhs, (size_t)rhs, #rhs, 0, "", __FILE__, __LINE__)
-#define BARO__CHECK_LE2(lhs, rhs, desc) baro__assert2(BARO__ASSERT_LE, (size_t)lhs, #lhs, (size_t)rhs, #rhs, 0, " " desc, __FILE__, __LINE__)
+#define BARO__CHECK_LE1(lhs, rhs) baro__assert2(BARO__ASSERT_LE, (lhs), #lhs, (rhs), #rhs, 0, "", __FILE__, __LINE__)
+#define BARO__CHECK_LE2(lhs, rhs, desc) baro__assert2(BARO__ASSERT_LE, (lhs), #lhs, (rhs), #rhs, 0, " " desc, __FILE__, __LINE__)
 
-#define BARO__REQUIRE_LE1(lhs, rhs) baro__assert2(BARO__ASSERT_LE, (size_t)lhs, #lhs, (size_t)rhs, #rhs, BARO__ASSERT_REQUIRE, "", __FILE__, __LINE__)
-#define BARO__REQUIRE_LE2(lhs, rhs, desc) baro__assert2(BARO__ASSERT_LE, (size_t)lhs, #lhs, (size_t)rhs, #rhs, BARO__ASSERT_REQUIRE, " " desc, __FILE__, __LINE__)
+#define BARO__REQUIRE_LE1(lhs, rhs) baro__assert2(BARO__ASSERT_LE, (lhs), #lhs, (rhs), #rhs, BARO__ASSERT_REQUIRE, "", __FILE__, __LINE__)
+#define BARO__REQUIRE_LE2(lhs, rhs, desc) baro__assert2(BARO__ASSERT_LE, (lhs), #lhs, (rhs), #rhs, BARO__ASSERT_REQUIRE, " " desc, __FILE__, __LINE__)
 
-#define BARO__CHECK_GT1(lhs, rhs) baro__assert2(BARO__ASSERT_GT, (size_t)lhs, #lhs, (size_t)rhs, #rhs, 0, "", __FILE__, __LINE__)
-#define BARO__CHECK_GT2(lhs, rhs, desc) baro__assert2(BARO__ASSERT_GT, (size_t)lhs, #lhs, (size_t)rhs, #rhs, 0, " " desc, __FILE__, __LINE__)
+#define BARO__CHECK_GT1(lhs, rhs) baro__assert2(BARO__ASSERT_GT, (lhs), #lhs, (rhs), #rhs, 0, "", __FILE__, __LINE__)
+#define BARO__CHECK_GT2(lhs, rhs, desc) baro__assert2(BARO__ASSERT_GT, (lhs), #lhs, (rhs), #rhs, 0, " " desc, __FILE__, __LINE__)
 
-#define BARO__REQUIRE_GT1(lhs, rhs) baro__assert2(BARO__ASSERT_GT, (size_t)lhs, #lhs, (size_t)rhs, #rhs, BARO__ASSERT_REQUIRE, "", __FILE__, __LINE__)
-#define BARO__REQUIRE_GT2(lhs, rhs, desc) baro__assert2(BARO__ASSERT_GT, (size_t)lhs, #lhs, (size_t)rhs, #rhs, BARO__ASSERT_REQUIRE, " " desc, __FILE__, __LINE__)
+#define BARO__REQUIRE_GT1(lhs, rhs) baro__assert2(BARO__ASSERT_GT, (lhs), #lhs, (rhs), #rhs, BARO__ASSERT_REQUIRE, "", __FILE__, __LINE__)
+#define BARO__REQUIRE_GT2(lhs, rhs, desc) baro__assert2(BARO__ASSERT_GT, (lhs), #lhs, (rhs), #rhs, BARO__ASSERT_REQUIRE, " " desc, __FILE__, __LINE__)
 
-#define BARO__CHECK_GE1(lhs, rhs) baro__assert2(BARO__ASSERT_GE, (size_t)lhs, #lhs, (size_t)rhs, #rhs, 0, "", __FILE__, __LINE__)
-#define BARO__CHECK_GE2(lhs, rhs, desc) baro__assert2(BARO__ASSERT_GE, (size_t)lhs, #lhs, (size_t)rhs, #rhs, 0, " " desc, __FILE__, __LINE__)
+#define BARO__CHECK_GE1(lhs, rhs) baro__assert2(BARO__ASSERT_GE, (lhs), #lhs, (rhs), #rhs, 0, "", __FILE__, __LINE__)
+#define BARO__CHECK_GE2(lhs, rhs, desc) baro__assert2(BARO__ASSERT_GE, (lhs), #lhs, (rhs), #rhs, 0, " " desc, __FILE__, __LINE__)
 
-#define BARO__REQUIRE_GE1(lhs, rhs) baro__assert2(BARO__ASSERT_GE, (size_t)lhs, #lhs, (size_t)rhs, #rhs, BARO__ASSERT_REQUIRE, "", __FILE__, __LINE__)
-#define BARO__REQUIRE_GE2(lhs, rhs, desc) baro__assert2(BARO__ASSERT_GE, (size_t)lhs, #lhs, (size_t)rhs, #rhs, BARO__ASSERT_REQUIRE, " " desc, __FILE__, __LINE__)
+#define BARO__REQUIRE_GE1(lhs, rhs) baro__assert2(BARO__ASSERT_GE, (lhs), #lhs, (rhs), #rhs, BARO__ASSERT_REQUIRE, "", __FILE__, __LINE__)
+#define BARO__REQUIRE_GE2(lhs, rhs, desc) baro__assert2(BARO__ASSERT_GE, (lhs), #lhs, (rhs), #rhs, BARO__ASSERT_REQUIRE, " " desc, __FILE__, __LINE__)
 
 #define BARO__CHECK_STR_EQ2(lhs, rhs) baro__assert_str(lhs, #lhs, rhs, #rhs, BARO__EXPECTING_TRUE, BARO__CASE_SENSITIVE, 0, "", __FILE__, __LINE__)
 #define BARO__CHECK_STR_EQ3(lhs, rhs, desc) baro__assert_str(lhs, #lhs, rhs, #rhs, BARO__EXPECTING_TRUE, BARO__CASE_SENSITIVE, 0, " " desc, __FILE__, __LINE__)
@@ -977,6 +1865,18 @@ BARO__X((__VA_ARGS__))
 #ifndef BARO_NO_SHORT
 #define TEST BARO_TEST
 #define SUBTEST BARO_SUBTEST
+#define BENCH BARO_BENCH
+#define BENCH_LOOP BARO_BENCH_LOOP
+#define DO_NOT_OPTIMIZE BARO_DO_NOT_OPTIMIZE
+#define CLOBBER_MEMORY BARO_CLOBBER_MEMORY
+#define CHECK_MAX_INSTRUCTIONS BARO_CHECK_MAX_INSTRUCTIONS
+#define REQUIRE_MAX_INSTRUCTIONS BARO_REQUIRE_MAX_INSTRUCTIONS
+#define CHECK_MAX_ALLOCS BARO_CHECK_MAX_ALLOCS
+#define REQUIRE_MAX_ALLOCS BARO_REQUIRE_MAX_ALLOCS
+#define CHECK_NO_ALLOCS BARO_CHECK_NO_ALLOCS
+#define REQUIRE_NO_ALLOCS BARO_REQUIRE_NO_ALLOCS
+#define CHECK_WITHIN_MS BARO_CHECK_WITHIN_MS
+#define REQUIRE_WITHIN_MS BARO_REQUIRE_WITHIN_MS
 #define CHECK BARO_CHECK
 #define REQUIRE BARO_REQUIRE
 #define CHECK_FALSE BARO_CHECK_FALSE
@@ -1,5 +1,9 @@
 #include "baro.h"
 
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
 #ifndef BARO_SELF_TEST
 #error These unit tests are for baro itself and should not be used externally
 #endif
@@ -45,6 +49,16 @@ TEST("Asserts") {
     REQUIRE_GE(3, 3);
     REQUIRE_GE(3, 3, "Greater than or equal to");
 
+    // Both sides are compared as C would compare them
+    int const minus_one = -1;
+    CHECK_LT(minus_one, 0, "signed");
+    CHECK_LT(-2.5, 1.0, "floating");
+    CHECK_NE(0.1 + 0.2, 0.3, "floating");
+    CHECK_GT(0.5f, 0.25, "mixed floating");
+    CHECK_LT(minus_one, 1.5, "mixed signed and floating");
+    CHECK_EQ(&minus_one, &minus_one, "pointers");
+    CHECK_NE(&minus_one, NULL, "pointers");
+
     CHECK_STR_EQ("bar", &"foobar"[3]);
     CHECK_STR_EQ("bar", &"foobar"[3], "Equal (case sensitive)");
     REQUIRE_STR_EQ("bar", &"foobar"[3]);
@@ -66,12 +80,6 @@ TEST("Asserts") {
     REQUIRE_STR_ICASE_NE("bar", "foobar", "Not equal (case insensitive)");
 }
 
-static inline void baro__tag_list_destroy(struct baro__tag_list *list) {
-    if (list->tags) {
-        free(list->tags);
-    }
-}
-
 TEST("Tag list") {
     struct baro__tag_list list;
     baro__tag_list_create(&list, 2);
@@ -131,5 +139,210 @@ TEST("Tag list") {
         baro__tag_list_destroy(&list2);
     }
 
+    SUBTEST("Hashes are kept per level") {
+        baro__tag_list_push(&list, &a);
+        uint64_t const hash_a = baro__tag_list_hash(&list);
+        baro__tag_list_push(&list, &b);
+        uint64_t const hash_ab = baro__tag_list_hash(&list);
+
+        // Grow past the initial capacity
+        baro__tag_list_push(&list, &a);
+        baro__tag_list_push(&list, &b);
+        CHECK_NE(baro__tag_list_hash(&list), hash_ab, "the same tags at other depths hash differently");
+
+        baro__tag_list_pop(&list, NULL);
+        baro__tag_list_pop(&list, NULL);
+        CHECK_EQ(baro__tag_list_hash(&list), hash_ab);
+
+        baro__tag_list_pop(&list, NULL);
+        CHECK_EQ(baro__tag_list_hash(&list), hash_a);
+
+        baro__tag_list_clear(&list);
+        baro__tag_list_push(&list, &a);
+        CHECK_EQ(baro__tag_list_hash(&list), hash_a, "pushing after a clear starts over");
+    }
+
     baro__tag_list_destroy(&list);
 }
+
+TEST("Subtest trie") {
+    struct baro__subtest_trie trie;
+    baro__subtest_trie_create(&trie);
+
+    struct baro__tag a = {.desc = "desc 1", .file_path = "file 1", .line_num = 123};
+    struct baro__tag b = {.desc = "desc 2", .file_path = "file 2", .line_num = 456};
+
+    CHECK_FALSE(baro__subtest_trie_find(&trie, 0, &a), "an empty trie has no children");
+
+    size_t const node_a = baro__subtest_trie_add(&trie, 0, &a);
+    size_t const node_b = baro__subtest_trie_add(&trie, 0, &b);
+    size_t const node_ab = baro__subtest_trie_add(&trie, node_a, &b);
+
+    CHECK_EQ(baro__subtest_trie_find(&trie, 0, &a), node_a);
+    CHECK_EQ(baro__subtest_trie_find(&trie, 0, &b), node_b);
+    CHECK_EQ(baro__subtest_trie_find(&trie, node_a, &b), node_ab, "children are looked up per parent");
+    CHECK_FALSE(baro__subtest_trie_find(&trie, node_b, &a));
+    CHECK_EQ(trie.nodes[node_ab].parent, node_a);
+
+    SUBTEST("Growing keeps existing nodes") {
+        size_t parent = node_ab;
+        for (int i = 0; i < 64; i++) {
+            parent = baro__subtest_trie_add(&trie, parent, &a);
+        }
+
+        CHECK_EQ(baro__subtest_trie_find(&trie, node_a, &b), node_ab);
+        CHECK_EQ(baro__subtest_trie_find(&trie, 0, &b), node_b);
+    }
+
+    SUBTEST("Wide trees find every sibling") {
+        struct baro__tag siblings[1000];
+        size_t nodes[1000];
+        for (size_t i = 0; i < 1000; i++) {
+            siblings[i] = a;
+            nodes[i] = baro__subtest_trie_add(&trie, node_b, &siblings[i]);
+        }
+
+        for (size_t i = 0; i < 1000; i++) {
+            REQUIRE_EQ(baro__subtest_trie_find(&trie, node_b, &siblings[i]), nodes[i]);
+            REQUIRE_FALSE(baro__subtest_trie_find(&trie, node_a, &siblings[i]));
+        }
+        CHECK_EQ(baro__subtest_trie_find(&trie, node_a, &b), node_ab);
+
+        // Mark every slot but the one of a single node, so that a clear that
+        // went through the whole grown index would show
+        baro__subtest_trie_clear(&trie);
+        size_t const node = baro__subtest_trie_add(&trie, 0, &a);
+        size_t const num_slots = trie.capacity * 2;
+        for (size_t i = 0; i < num_slots; i++) {
+            if (trie.index[i] != node) {
+                trie.index[i] = SIZE_MAX;
+            }
+        }
+
+        baro__subtest_trie_clear(&trie);
+        size_t num_untouched = 0;
+        for (size_t i = 0; i < num_slots; i++) {
+            num_untouched += trie.index[i] == SIZE_MAX;
+            trie.index[i] = 0;
+        }
+        CHECK_EQ(num_untouched, num_slots - 1, "clearing only empties the slots of added nodes");
+    }
+
+    SUBTEST("Clearing forgets every node") {
+        baro__subtest_trie_clear(&trie);
+
+        CHECK_FALSE(baro__subtest_trie_find(&trie, 0, &a));
+        CHECK_FALSE(baro__subtest_trie_find(&trie, 0, &b));
+        CHECK_EQ(baro__subtest_trie_add(&trie, 0, &b), 1);
+    }
+
+    baro__subtest_trie_destroy(&trie);
+}
+
+TEST("Test list sort") {
+    // Separate arrays, so that the same path is stored at two addresses
+    static char const file_a[] = "a.c";
+    static char const file_a_copy[] = "a.c";
+    static char const file_b[] = "b.c";
+
+    struct baro__tag const tags[] = {
+        {.desc = "0", .file_path = file_b, .line_num = 1},
+        {.desc = "1", .file_path = file_a_copy, .line_num = 70000},
+        {.desc = "2", .file_path = file_a, .line_num = 300},
+        {.desc = "3", .file_path = file_a, .line_num = 5},
+        {.desc = "4", .file_path = file_a_copy, .line_num = 300},
+    };
+
+    struct baro__test_list list;
+    baro__test_list_create(&list, 1);
+    for (size_t i = 0; i < sizeof(tags) / sizeof(tags[0]); i++) {
+        struct baro__test const test = {.tag = &tags[i]};
+        baro__test_list_add(&list, &test);
+    }
+
+    baro__test_list_sort(&list);
+
+    REQUIRE_EQ(list.size, 5);
+    CHECK_EQ(list.tests[0].tag, &tags[3]);
+    CHECK_EQ(list.tests[1].tag, &tags[2], "ties keep their original order");
+    CHECK_EQ(list.tests[2].tag, &tags[4], "ties keep their original order");
+    CHECK_EQ(list.tests[3].tag, &tags[1], "paths are compared by contents");
+    CHECK_EQ(list.tests[4].tag, &tags[0]);
+
+    free(list.tests);
+}
+
+static int num_looped_subtests;
+static int num_looped_passes;
+
+TEST("Instruction budgets are skipped without counters") {
+#ifdef __linux__
+    // Opens the counters where they can be, and then stops them from counting
+    baro__read_counter(BARO__COUNTER_INSTRUCTIONS);
+    prctl(PR_TASK_PERF_EVENTS_DISABLE, 0, 0, 0, 0);
+#endif
+
+    // Any work at all would go over these, if it were counted
+    int volatile sum = 0;
+    CHECK_MAX_INSTRUCTIONS(0) {
+        for (int i = 0; i < 100; i++) {
+            sum += i;
+        }
+    }
+    REQUIRE_MAX_INSTRUCTIONS(0) {
+        for (int i = 0; i < 100; i++) {
+            sum += i;
+        }
+    }
+    CHECK_EQ(sum, 9900);
+
+#ifdef __linux__
+    prctl(PR_TASK_PERF_EVENTS_ENABLE, 0, 0, 0, 0);
+#endif
+}
+
+// Implemented by the runner when built with BARO_SELF_TEST
+double baro__mann_whitney_p(double const *current, size_t num_current, double const *baseline, size_t num_baseline);
+
+TEST("Mann-Whitney U test") {
+    double const low[] = {1, 2, 3, 4, 5};
+    double const high[] = {6, 7, 8, 9, 10};
+
+    SUBTEST("Fully separated samples give the smallest p-value") {
+        // Only one of the C(10, 5) orderings puts all of them above
+        CHECK_EQ(baro__mann_whitney_p(high, 5, low, 5), 1.0 / 252);
+        CHECK_EQ(baro__mann_whitney_p(low, 5, high, 5), 1.0);
+    }
+
+    SUBTEST("Interleaved samples") {
+        // U = 6, and 7 of the 20 orderings of 3 and 3 give at least that
+        double const current[] = {2, 4, 6};
+        double const baseline[] = {1, 3, 5};
+        CHECK_EQ(baro__mann_whitney_p(current, 3, baseline, 3), 7.0 / 20);
+    }
+
+    SUBTEST("Ties count half") {
+        // U = 2, and 4 of the 6 orderings of 2 and 2 give at least that
+        double const same[] = {4, 4};
+        CHECK_EQ(baro__mann_whitney_p(same, 2, same, 2), 4.0 / 6);
+    }
+
+    SUBTEST("Unequal sample sizes") {
+        // U = 4 for 1 and 4 samples is only reached by the one ordering of 5
+        CHECK_EQ(baro__mann_whitney_p(high, 1, low, 4), 1.0 / 5);
+    }
+}
+
+TEST("Completed subtests are skipped without another pass") {
+    num_looped_passes++;
+
+    // The same subtest is reached on every iteration, but only ever runs once
+    for (int i = 0; i < 3; i++) {
+        SUBTEST("looped") {
+            num_looped_subtests++;
+        }
+    }
+
+    CHECK_EQ(num_looped_subtests, 1);
+    CHECK_EQ(num_looped_passes, 1);
+}
@@ -0,0 +1,67 @@
+#include <baro.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+struct buffer {
+    char *data;
+    size_t size;
+    size_t capacity;
+};
+
+static void buffer_append(struct buffer *buffer, char const *text) {
+    size_t const size = strlen(text);
+    if (buffer->size + size > buffer->capacity) {
+        buffer->capacity = (buffer->size + size) * 2;
+        buffer->data = realloc(buffer->data, buffer->capacity);
+    }
+    memcpy(buffer->data + buffer->size, text, size);
+    buffer->size += size;
+}
+
+TEST("appending within capacity doesn't allocate") {
+    struct buffer buffer = {0};
+    buffer_append(&buffer, "hello");
+
+    REQUIRE_NO_ALLOCS {
+        buffer_append(&buffer, " you");
+    }
+    CHECK_EQ(buffer.size, 9);
+    free(buffer.data);
+}
+
+TEST("appending grows the buffer") {
+    struct buffer buffer = {0};
+    CHECK_MAX_ALLOCS(1) {
+        for (int i = 0; i < 4; i++) {
+            buffer_append(&buffer, "a longer piece of text");
+        }
+    }
+    free(buffer.data);
+}
+
+TEST("leaks") {
+    char *name = strdup("not freed");
+    CHECK_STR_EQ(name, "not freed");
+
+    SUBTEST("in a subtest") {
+        struct buffer buffer = {0};
+        buffer_append(&buffer, "also not freed");
+    }
+
+    SUBTEST("freed") {
+        struct buffer buffer = {0};
+        buffer_append(&buffer, "freed");
+        free(buffer.data);
+    }
+}
+
+TEST("the runner's own buffers aren't counted") {
+    // Discovering this many subtests grows the runner's tree of them
+    CHECK_NO_ALLOCS {
+        SUBTEST("1") {} SUBTEST("2") {} SUBTEST("3") {} SUBTEST("4") {} SUBTEST("5") {}
+        SUBTEST("6") {} SUBTEST("7") {} SUBTEST("8") {} SUBTEST("9") {} SUBTEST("10") {}
+        SUBTEST("11") {} SUBTEST("12") {} SUBTEST("13") {} SUBTEST("14") {} SUBTEST("15") {}
+        SUBTEST("16") {} SUBTEST("17") {} SUBTEST("18") {} SUBTEST("19") {} SUBTEST("20") {}
+    }
+}
@@ -0,0 +1,32 @@
+#include <baro.h>
+
+// Assuming the suite is executed with "--bench --bench-time 10 --compare
+// baselines.baseline", each benchmark is compared with the samples saved for
+// it. The saved samples take a second per iteration, so nothing here regressed.
+// Times differ from run to run, so they are replaced before comparing.
+
+static unsigned sum_up_to(unsigned n) {
+    unsigned sum = 0;
+    for (unsigned i = 0; i < n; i++) {
+        sum += i;
+    }
+    return sum;
+}
+
+// Found by its test ID
+BENCH("sum the first hundred numbers") {
+    unsigned sum = sum_up_to(100);
+    BARO_DO_NOT_OPTIMIZE(sum);
+}
+
+// Saved under another name, and found by its file and line instead
+BENCH("sum the first thousand numbers") {
+    unsigned sum = sum_up_to(1000);
+    BARO_DO_NOT_OPTIMIZE(sum);
+}
+
+// Not in the baselines at all
+BENCH("sum the first ten numbers") {
+    unsigned sum = sum_up_to(10);
+    BARO_DO_NOT_OPTIMIZE(sum);
+}
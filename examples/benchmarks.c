@@ -0,0 +1,49 @@
+#include <baro.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static int int_cmp(void const *a, void const *b) {
+    int const lhs = *(int const *) a;
+    int const rhs = *(int const *) b;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+static size_t count_words(char const *text) {
+    size_t words = 0;
+    for (int in_word = 0; *text; text++) {
+        int const is_space = *text == ' ';
+        words += !is_space && !in_word;
+        in_word = !is_space;
+    }
+    return words;
+}
+
+TEST("counts words") {
+    CHECK_EQ(count_words(""), 0);
+    CHECK_EQ(count_words("one"), 1);
+    CHECK_EQ(count_words("  two words "), 2);
+}
+
+// Only runs with --bench, and is timed as a whole
+BENCH("count words in a sentence") {
+    size_t words = count_words("the quick brown fox jumps over the lazy dog");
+    DO_NOT_OPTIMIZE(words);
+}
+
+// Only the loop is timed, leaving the setup out
+BENCH("sort 1000 integers") {
+    int unsorted[1000];
+    int values[1000];
+    for (int i = 0; i < 1000; i++) {
+        unsorted[i] = (i * 7919) % 1000;
+    }
+
+    BENCH_LOOP {
+        memcpy(values, unsorted, sizeof(values));
+        qsort(values, 1000, sizeof(int), int_cmp);
+        CLOBBER_MEMORY();
+    }
+
+    REQUIRE_EQ(values[0], 0);
+}
@@ -0,0 +1,18 @@
+#include <baro.h>
+
+// Assuming the suite is executed with "-n 1 -p 2 --durations
+// duration_partitioning.durations", the tests are balanced across the two
+// partitions by how long they took last time, rather than by their order:
+//
+// Partition 1: "slow" (5000 us)
+// Partition 2: "medium" (3000 us), "quick *" (10 us each), "new" (unknown)
+//
+// Tests without a recorded duration are assumed to take an average amount of
+// time. The durations file is rewritten with this run's timings afterwards.
+
+TEST("slow") { REQUIRE(0); }
+TEST("quick 1") { REQUIRE(0); }
+TEST("quick 2") { REQUIRE(0); }
+TEST("medium") { REQUIRE(0); }
+TEST("quick 3") { REQUIRE(0); }
+TEST("new") { REQUIRE(0); }
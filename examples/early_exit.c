@@ -0,0 +1,21 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <baro.h>
+
+// A test that ends the process takes the rest of the suite with it, but what
+// it wrote before then is still shown, as are sanitizer reports for crashes
+
+TEST("runs before the exit") {
+    CHECK(1);
+}
+
+TEST("exits in the middle") {
+    printf("buffered before the exit\n");
+    fprintf(stderr, "giving up\n");
+    exit(3);
+}
+
+TEST("never runs") {
+    CHECK(0);
+}
@@ -0,0 +1,48 @@
+#include <baro.h>
+#include <signal.h>
+
+// Assuming the suite is executed with "--fork-subtests -a", each subtest runs
+// in a process forked from the one that reached it. The code leading up to a
+// subtest runs only once, rather than once for every subtest below it, and
+// every subtest starts from the state its parent had built so far. Failures
+// still end the test just like they would without forking.
+
+static int num_setups = 0;
+
+TEST("setup runs once") {
+    num_setups++;
+    int value = 1;
+
+    SUBTEST("changes state") {
+        value = 2;
+        CHECK_EQ(num_setups, 1);
+    }
+    SUBTEST("sees none of its siblings' changes") {
+        CHECK_EQ(value, 1);
+        CHECK_EQ(num_setups, 1);
+    }
+    SUBTEST("nested") {
+        value = 3;
+
+        SUBTEST("inner 1") {
+            CHECK_EQ(value, 3);
+        }
+        SUBTEST("inner 2") {
+            REQUIRE_EQ(value, 4); // should fail
+        }
+    }
+}
+
+TEST("a crashing subtest ends only its own test") {
+    SUBTEST("crashes") {
+        raise(SIGKILL);
+    }
+    // will not be executed, as after any other REQUIRE failure
+    SUBTEST("skipped") {
+        CHECK(0);
+    }
+}
+
+TEST("later tests still run") {
+    CHECK(1);
+}
@@ -0,0 +1,54 @@
+#include <baro.h>
+#include <signal.h>
+
+// Assuming the suite is executed with "--fork-workers 1 -a", the single worker
+// takes the tests from the queue a few at a time. When a test takes it down in
+// the middle of such a batch, its replacement picks up the rest of the batch.
+
+TEST("kills the worker first") {
+    raise(SIGKILL);
+}
+
+TEST("rest of the batch 1") {
+    CHECK(1);
+}
+
+TEST("rest of the batch 2") {
+    CHECK(1);
+}
+
+TEST("later batch 1") {
+    CHECK(1);
+}
+
+TEST("later batch 2") {
+    CHECK(1);
+}
+
+TEST("exits in the middle of a batch") {
+    exit(3);
+}
+
+TEST("later batch 3") {
+    CHECK(1);
+}
+
+TEST("later batch 4") {
+    CHECK(1);
+}
+
+TEST("later batch 5") {
+    CHECK(1);
+}
+
+TEST("later batch 6") {
+    CHECK(1);
+}
+
+TEST("later batch 7") {
+    CHECK(1);
+}
+
+TEST("last") {
+    CHECK(1);
+}
@@ -0,0 +1,33 @@
+#include <baro.h>
+#include <signal.h>
+
+// Assuming the suite is executed with "--fork-workers 2 -a", each test runs in
+// one of two worker processes. The report is still printed in test order, and
+// a test that takes its worker down doesn't take the rest of the suite with it.
+
+TEST("before the crash") {
+    CHECK(1);
+}
+
+TEST("kills its worker") {
+    printf("about to go down\n");
+    raise(SIGKILL);
+}
+
+TEST("exits its worker") {
+    exit(3);
+}
+
+TEST("after the crash") {
+    CHECK(1);
+    CHECK(0); // should fail
+}
+
+TEST("subtests still work") {
+    SUBTEST("a") {
+        CHECK(1);
+    }
+    SUBTEST("b") {
+        CHECK(1);
+    }
+}
@@ -0,0 +1,29 @@
+#include <baro.h>
+
+// Assuming the suite is executed with "--format jsonl", "--format junit" or
+// "--format tap", results are written for other tools to read, with the text
+// of each test's reports and captured output escaped for the format. Durations
+// differ from run to run, so they are zeroed out before comparing.
+
+TEST("[net] [slow] passes with tags") {
+    CHECK(1);
+}
+
+TEST("has \"quotes\", <&> and # in its name") {
+    CHECK(1);
+}
+
+TEST("[net] fails in a subtest") {
+    printf("before the subtests\n");
+
+    SUBTEST("that passes") {
+        CHECK(1);
+    }
+
+    SUBTEST("that fails") {
+        printf("inside the failing subtest\n");
+        CHECK_EQ(1, 2);
+    }
+
+    printf("after the failure\n");
+}
@@ -0,0 +1,9 @@
+#include <baro.h>
+
+// This file is linked with mixed_registration_constructors.c, which is built
+// with BARO_NO_TEST_SECTION, so its tests are registered by constructors
+// rather than placed in a section by the linker. Tests from both are run.
+
+TEST("from the section") {
+    CHECK(1);
+}
@@ -0,0 +1,10 @@
+#define BARO_NO_TEST_SECTION
+#include <baro.h>
+
+TEST("from a constructor") {
+    CHECK(1);
+}
+
+TEST("from another constructor") {
+    CHECK(1);
+}
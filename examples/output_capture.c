@@ -0,0 +1,34 @@
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <baro.h>
+
+// Assuming the suite is executed with "--output-tail 32", only the last 32
+// bytes that a failing test wrote to stdout and stderr are shown. Output is
+// captured at the file descriptor, so it includes whatever is written by other
+// libraries and child processes, too.
+
+TEST("only the tail of long output is shown") {
+    for (int i = 0; i < 1000; i++) {
+        printf("line %d\n", i);
+    }
+    CHECK(0);
+}
+
+TEST("output that bypasses stdio is captured") {
+    ssize_t const written = write(1, "written to fd 1\n", 16);
+    (void) written;
+    CHECK(system("echo from a child") == 0);
+    CHECK(0);
+}
+
+TEST("stdout and stderr are kept in order") {
+    printf("out 1\n");
+    fprintf(stderr, "err 1\n");
+    printf("out 2\n");
+    CHECK(0);
+}
+
+TEST("output is forgotten between tests") {
+    CHECK(0);
+}
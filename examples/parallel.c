@@ -0,0 +1,39 @@
+#include <baro.h>
+
+// Assuming the suite is executed with "-j 4", these tests are spread across
+// four worker threads. Only the one failure is reported, and the summary
+// counts are merged from every worker.
+
+static size_t fib(size_t n) {
+    return n < 2 ? n : fib(n - 1) + fib(n - 2);
+}
+
+TEST("fib 1") { CHECK_EQ(fib(1), 1); }
+TEST("fib 2") { CHECK_EQ(fib(2), 1); }
+TEST("fib 3") { CHECK_EQ(fib(3), 2); }
+TEST("fib 4") { CHECK_EQ(fib(4), 3); }
+TEST("fib 5") { CHECK_EQ(fib(5), 5); }
+TEST("fib 6") { CHECK_EQ(fib(6), 8); }
+TEST("fib 7") { CHECK_EQ(fib(7), 13); }
+TEST("fib 8") { CHECK_EQ(fib(8), 21); }
+
+TEST("fib 20 with subtests") {
+    size_t const expected = 6765;
+
+    SUBTEST("recursive") {
+        CHECK_EQ(fib(20), expected);
+    }
+    SUBTEST("iterative") {
+        size_t a = 0, b = 1;
+        for (int i = 0; i < 20; i++) {
+            size_t const c = a + b;
+            a = b;
+            b = c;
+        }
+        CHECK_EQ(a, expected);
+    }
+}
+
+TEST("fib 9") {
+    CHECK_EQ(fib(9), 35); // should fail
+}
@@ -0,0 +1,25 @@
+#include <baro.h>
+
+// Each shard writes its results to a file of its own:
+// ./example_result_merging -n 1 -p 2 --results shard_1.results
+// ./example_result_merging -n 2 -p 2 --results shard_2.results
+
+// And a single report is made out of all of them:
+// ./example_result_merging -a --merge shard_1.results shard_2.results
+
+TEST("Shard 1 passes") {
+    CHECK_EQ(1 + 1, 2);
+}
+
+TEST("Shard 1 fails") {
+    printf("Some output from the first shard\n");
+    CHECK_EQ(1 + 1, 3);
+}
+
+TEST("Shard 2 passes") {
+    CHECK_EQ(2 + 2, 4);
+}
+
+TEST("Shard 2 fails") {
+    REQUIRE_EQ(2 + 2, 5);
+}
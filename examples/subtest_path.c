@@ -0,0 +1,30 @@
+#include <baro.h>
+
+// Assuming the suite is executed with '--path "parsing>lists>nested" -a', only
+// the "parsing" test runs, and only the subtests along the path are entered.
+// Everything nested below the last subtest in the path still runs.
+
+TEST("parsing") {
+    printf("setup\n");
+
+    SUBTEST("numbers") {
+        CHECK(0); // not on the path
+    }
+    SUBTEST("lists") {
+        SUBTEST("empty") {
+            CHECK(0); // not on the path
+        }
+        SUBTEST("nested") {
+            SUBTEST("once") {
+                CHECK(1);
+            }
+            SUBTEST("twice") {
+                CHECK_EQ(1 + 1, 3); // should fail
+            }
+        }
+    }
+}
+
+TEST("printing") {
+    CHECK(0); // not on the path
+}
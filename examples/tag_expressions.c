@@ -0,0 +1,25 @@
+#include <baro.h>
+
+// Assuming the suite is executed with -t "(net | disk) & !flaky":
+
+TEST("[net] This test will be ran") {
+    REQUIRE(0);
+}
+
+TEST("[disk] [slow] This test will also be ran") {
+    REQUIRE(0);
+}
+
+TEST("[net] [flaky] But not this one") {
+    REQUIRE(0);
+}
+
+TEST("[cpu] Nor this one") {
+    REQUIRE(0);
+}
+
+// Hidden tests never run unless the expression names [.] itself, as in
+// -t ". & net", or the test is picked out with --path
+TEST("[.] [net] Or this hidden one") {
+    REQUIRE(0);
+}
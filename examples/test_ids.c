@@ -0,0 +1,27 @@
+#include <baro.h>
+
+// Every test has an ID, which `--list` prints along with where the test is.
+// Assuming the suite is executed with "--ids test_ids.ids", where that file
+// holds some of those IDs:
+
+TEST("[net] This test will be ran") {
+    REQUIRE(0);
+}
+
+TEST("[net] But not this one") {
+    REQUIRE(0);
+}
+
+// Tests named by ID run even when they are hidden
+TEST("[.] [slow] This hidden test will also be ran") {
+    REQUIRE(0);
+}
+
+// Tests that share a description get IDs of their own, told apart by line
+TEST("Only this copy of a test will be ran") {
+    REQUIRE(0);
+}
+
+TEST("Only this copy of a test will be ran") {
+    REQUIRE(0);
+}
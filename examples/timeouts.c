@@ -0,0 +1,32 @@
+#include <baro.h>
+
+// Assuming the suite is executed with "--timeout 100 -a", a test that is still
+// running after 100 ms fails, and the run moves on to the next one. A block
+// can also be given a time budget of its own, which it fails if it runs over.
+
+static int volatile done;
+
+static void wait_until_done(void) {
+    while (!done) {
+    }
+}
+
+TEST("finishes in time") {
+    REQUIRE_WITHIN_MS(1000) {
+        CHECK_EQ(1 + 1, 2);
+    }
+}
+
+TEST("hangs in a subtest") {
+    SUBTEST("that never finishes") {
+        wait_until_done();
+    }
+
+    SUBTEST("that isn't reached") {
+        CHECK(1);
+    }
+}
+
+TEST("runs after the one that hung") {
+    CHECK(1);
+}
@@ -0,0 +1,39 @@
+#include <baro.h>
+
+// Assuming the suite is executed with "-n 1 -p 2 --trees
+// tree_partitioning.trees", the tests are balanced across the two partitions
+// by how many passes their subtests take, rather than by their order:
+//
+// Partition 1: "wide" (6 passes), "single 3" (1 pass)
+// Partition 2: "pair" (2 passes), "new" (unknown), "single 1" and "single 2"
+//              (1 pass each)
+//
+// Tests without a recorded tree are assumed to take an average number of
+// passes, which comes to 2 here. The trees file was written by running the suite with "--discover
+// tree_partitioning.trees", before "new" was added.
+
+TEST("single 1") {}
+
+TEST("wide") {
+    SUBTEST("a") {
+        SUBTEST("1") {}
+        SUBTEST("2") {}
+        SUBTEST("3") {}
+    }
+    SUBTEST("b") {}
+    SUBTEST("c") {
+        SUBTEST("1") {}
+        SUBTEST("2") {}
+    }
+}
+
+TEST("single 2") {}
+
+TEST("pair") {
+    SUBTEST("a") {}
+    SUBTEST("b") {}
+}
+
+TEST("single 3") {}
+
+TEST("new") {}